@@ -19,7 +19,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/errno.h>
+#include <sys/un.h>
 #include <getopt.h>
 
 #include "libbridge.h"
@@ -27,61 +29,254 @@
 
 #include "brctl.h"
 
+int jobs = 1;
+int format = FORMAT_TEXT;
+
+/* ask brstatd listening here instead of the kernel (--daemon) */
+static const char *daemon_socket;
+
 static void help()
 {
-	printf("Usage: brctl [commands]\n");
-	printf("commands:\n");
+	out_str("Usage: brctl [-b file] [-j jobs] [-f text|json|tsv] "
+		"[--daemon[=socket]] [commands]\n");
+	out_str("commands:\n");
 	command_helpall();
 }
 
-int main(int argc, char *const* argv)
+/*
+ * Send a command to brstatd and pass on its answer: messages
+ * for standard error, the exit status, then the output.
+ */
+static int run_remote(int argc, char *const* argv)
+{
+	static const char *formats[] = { "text", "json", "tsv" };
+	struct sockaddr_un sun;
+	char *line = NULL, buf[4096];
+	size_t len = 0, n;
+	int fd, i, status = -1;
+	FILE *f;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strncpy(sun.sun_path, daemon_socket, sizeof(sun.sun_path) - 1);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0) {
+		fprintf(stderr, "can't reach brstatd at %s: %s\n",
+			daemon_socket, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return 1;
+	}
+
+	f = fdopen(fd, "r+");
+	if (!f) {
+		close(fd);
+		return 1;
+	}
+
+	fputs(formats[format], f);
+	for (i = 0; i < argc; i++) {
+		fputc(' ', f);
+		fputs(argv[i], f);
+	}
+	fputc('\n', f);
+	fflush(f);
+
+	while (getline(&line, &len, f) != -1) {
+		if (line[0] == '!')
+			fputs(line + 1, stderr);
+		else {
+			if (line[0] == '=')
+				status = atoi(line + 1);
+			break;
+		}
+	}
+	free(line);
+
+	if (status < 0)
+		fprintf(stderr, "no answer from brstatd\n");
+	else
+		while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+			out_mem(buf, n);
+
+	fclose(f);
+	return status < 0 ? 1 : status;
+}
+
+/*
+ * Run one command; argv[0] is the command name.
+ * Returns -1 if the command is unknown.
+ */
+static int run_command(int argc, char *const* argv)
 {
 	const struct command *cmd;
-	int f;
+
+	/* brstatd knows what it answers, and refresh */
+	if (daemon_socket)
+		return run_remote(argc, argv);
+
+	if ((cmd = command_lookup(*argv)) == NULL) {
+		fprintf(stderr, "never heard of command [%s]\n", *argv);
+		return -1;
+	}
+
+	if (argc < cmd->nargs + 1) {
+		out_str("Incorrect number of arguments for command\n");
+		out_printf("Usage: brctl %s %s\n", cmd->name, cmd->help);
+		return 1;
+	}
+
+	return cmd->func(argc, argv);
+}
+
+/*
+ * Read commands one per line from file (or stdin if "-") and
+ * run them all in this process, sharing the bridge control socket.
+ * A failing line is reported but does not stop the batch.
+ */
+static int run_batch(const char *name)
+{
+	FILE *f;
+	char *line = NULL;
+	size_t len = 0;
+	char **args = NULL;
+	int maxargs = 0;
+	int lineno = 0, errors = 0;
+
+	if (strcmp(name, "-") == 0)
+		f = stdin;
+	else if ((f = fopen(name, "r")) == NULL) {
+		fprintf(stderr, "can't open batch file %s: %s\n",
+			name, strerror(errno));
+		return 1;
+	}
+
+	while (getline(&line, &len, f) != -1) {
+		char *cp, *tok;
+		int argc = 0;
+
+		++lineno;
+		if ((cp = strchr(line, '#')) != NULL)
+			*cp = '\0';
+
+		for (tok = strtok(line, " \t\r\n"); tok;
+		     tok = strtok(NULL, " \t\r\n")) {
+			if (argc + 1 >= maxargs) {
+				maxargs = maxargs ? 2 * maxargs : 16;
+				args = realloc(args, maxargs * sizeof(char *));
+				if (!args) {
+					fprintf(stderr, "Out of memory\n");
+					return 1;
+				}
+			}
+			args[argc++] = tok;
+		}
+
+		if (argc == 0)
+			continue;
+		args[argc] = NULL;
+
+		/* the command's output goes before the error */
+		if (run_command(argc, args) != 0) {
+			out_flush();
+			fprintf(stderr, "%s:%d: command %s failed\n",
+				name, lineno, args[0]);
+			++errors;
+		}
+		out_flush();
+	}
+
+	free(args);
+	free(line);
+	if (f != stdin)
+		fclose(f);
+
+	return errors != 0;
+}
+
+int main(int argc, char *const* argv)
+{
+	const char *batch = NULL;
+	int f, ret;
 	static const struct option options[] = {
 		{ .name = "help", .val = 'h' },
 		{ .name = "version", .val = 'V' },
+		{ .name = "batch", .has_arg = required_argument, .val = 'b' },
+		{ .name = "jobs", .has_arg = required_argument, .val = 'j' },
+		{ .name = "format", .has_arg = required_argument, .val = 'f' },
+		{ .name = "daemon", .has_arg = optional_argument, .val = 'D' },
 		{ 0 }
 	};
 
-	while ((f = getopt_long(argc, argv, "Vh", options, NULL)) != EOF) 
+	/* stop at the command, its options are its own */
+	while ((f = getopt_long(argc, argv, "+Vhb:j:f:", options, NULL)) != EOF) 
 		switch(f) {
+		case 'b':
+			batch = optarg;
+			break;
+		case 'j':
+			if (sscanf(optarg, "%i", &jobs) != 1 || jobs < 1) {
+				fprintf(stderr, "bad number of jobs %s\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 'f':
+			if (!strcmp(optarg, "text"))
+				format = FORMAT_TEXT;
+			else if (!strcmp(optarg, "json"))
+				format = FORMAT_JSON;
+			else if (!strcmp(optarg, "tsv"))
+				format = FORMAT_TSV;
+			else {
+				fprintf(stderr, "unknown format %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'D':
+			daemon_socket = optarg ? optarg : BRSTATD_SOCKET;
+			break;
 		case 'h':
 			help();
-			return 0;
+			ret = 0;
+			goto out;
 		case 'V':
-			printf("%s, %s\n", PACKAGE_NAME, PACKAGE_VERSION);
-			return 0;
+			out_printf("%s, %s\n", PACKAGE_NAME, PACKAGE_VERSION);
+			ret = 0;
+			goto out;
 		default:
 			fprintf(stderr, "Unknown option '%c'\n", f);
 			goto help;
 		}
 			
-	if (argc == optind)
+	if (argc == optind && !batch)
 		goto help;
 	
-	if (br_init()) {
+	/* brstatd does the talking to the kernel */
+	if (!daemon_socket && br_init()) {
 		fprintf(stderr, "can't setup bridge control: %s\n",
 			strerror(errno));
 		return 1;
 	}
 
-	argc -= optind;
-	argv += optind;
-	if ((cmd = command_lookup(*argv)) == NULL) {
-		fprintf(stderr, "never heard of command [%s]\n", *argv);
-		goto help;
-	}
-	
-	if (argc < cmd->nargs + 1) {
-		printf("Incorrect number of arguments for command\n");
-		printf("Usage: brctl %s %s\n", cmd->name, cmd->help);
-		return 1;
+	if (batch) {
+		ret = run_batch(batch);
+		goto out;
 	}
 
-	return cmd->func(argc, argv);
+	argc -= optind;
+	argv += optind;
+	if ((ret = run_command(argc, argv)) >= 0)
+		goto out;
 
 help:
 	help();
-	return 1;
+	ret = 1;
+out:
+	if (out_flush() < 0 && ret == 0) {
+		fprintf(stderr, "write error: %s\n", strerror(errno));
+		ret = 1;
+	}
+	return ret;
 }
@@ -19,8 +19,8 @@
 #ifndef _BRCTL_H
 #define _BRCTL_H
 
-#define MAX_PORTS      1024
-#define VS_SEPARATOR 0xF0F0F0F0
+/* where brstatd answers brctl --daemon */
+#define BRSTATD_SOCKET	"/var/run/brstatd.sock"
 
 struct command
 {
@@ -30,13 +30,71 @@ struct command
 	const char 	*help;
 };
 
+/* number of threads collecting bridge information (-j) */
+extern int jobs;
+
+/* output of the show commands (--format) */
+enum {
+	FORMAT_TEXT,
+	FORMAT_JSON,
+	FORMAT_TSV,
+};
+extern int format;
+
 const struct command *command_lookup(const char *cmd);
 void command_help(const struct command *);
 void command_helpall(void);
 
-void br_dump_bridge_id(const unsigned char *x);
-void br_show_timer(const struct timeval *tv);
-void br_dump_interface_list(const char *br);
-void br_dump_info(const char *br, const struct bridge_info *bri);
+void br_dump_interface_list(const struct br_snapshot *snap,
+			    const struct br_snapshot_bridge *b);
+void br_dump_info(const struct br_snapshot *snap,
+		  const struct br_snapshot_bridge *b);
+void br_dump_info_json(const struct br_snapshot *snap,
+		       const struct br_snapshot_bridge *b);
+void br_dump_info_tsv_header(void);
+int br_dump_info_tsv(const struct br_snapshot *snap,
+		     const struct br_snapshot_bridge *b);
+void br_dump_bridge_json(const struct br_snapshot *snap,
+			 const struct br_snapshot_bridge *b);
+int br_dump_bridge_tsv(const struct br_snapshot *snap,
+		       const struct br_snapshot_bridge *b);
+void br_dump_bridge_header(void);
+void br_dump_bridge_footer(void);
+int br_dump_bridge(const struct br_snapshot *snap,
+		   const struct br_snapshot_bridge *b);
+void br_dump_bridge_error(const char *name, int err);
+int br_dump_stp(const struct br_snapshot *snap,
+		const struct br_snapshot_bridge *b, int n);
+void br_dump_fdb_header(int has_nick);
+void br_dump_fdb_footer(void);
+void br_dump_fdb(const unsigned char *mac, int port_no, int nick,
+		 int is_local, const struct timeval *ageing);
+void br_dump_vs(const struct br_vni_table *t);
+int sort_fdbs(void *fdbs, size_t n, size_t size);
+
+/* buffered standard output, see brctl_out.c */
+void out_init(int fd);
+int out_flush(void);
+void out_mem(const char *s, size_t len);
+void out_str(const char *s);
+void out_char(char c);
+void out_int(int v, int width);
+void out_hex(unsigned int v, int digits);
+void out_mac(const unsigned char *mac);
+void out_bridge_id(const unsigned char *id);
+void out_timer(const struct timeval *tv);
+void out_printf(const char *fmt, ...)
+	__attribute__ ((format (printf, 1, 2)));
+void out_tsv_str(const char *s);
+void out_tsv_timer(const struct timeval *tv);
+void json_open(const char *key, char bracket);
+void json_close(char bracket);
+void json_str(const char *key, const char *value);
+void json_int(const char *key, int value);
+void json_bool(const char *key, int value);
+void json_hex(const char *key, unsigned int value, int digits);
+void json_mac(const char *key, const unsigned char *mac);
+void json_bridge_id(const char *key, const unsigned char *id);
+void json_timer(const char *key, const struct timeval *tv);
 
 #endif
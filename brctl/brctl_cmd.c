@@ -20,7 +20,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <time.h>
 #include <errno.h>
+#include <fnmatch.h>
 #include <asm/param.h>
 #include "libbridge.h"
 #include "brctl.h"
@@ -96,7 +98,7 @@ static int br_cmd_addif(int argc, char *const* argv)
 			continue;
 
 		case ENODEV:
-			if (if_nametoindex(ifname) == 0)
+			if (br_if_nametoindex(ifname) == 0)
 				fprintf(stderr, "interface %s does not exist!\n", ifname);
 			else
 				fprintf(stderr, "bridge %s does not exist!\n", brname);
@@ -139,7 +141,7 @@ static int br_cmd_delif(int argc, char *const* argv)
 			continue;
 
 		case ENODEV:
-			if (if_nametoindex(ifname) == 0)
+			if (br_if_nametoindex(ifname) == 0)
 				fprintf(stderr, "interface %s does not exist!\n", ifname);
 			else
 				fprintf(stderr, "bridge %s does not exist!\n", brname);
@@ -329,15 +331,17 @@ static int br_cmd_setvni(int argc, char* const* argv)
 		fprintf(stderr, "s-vid must be in range [1..16777215] \n");
 		return 1;
 	}
-	vni = (((label &0x0FFF000) << 4  ) | (label & 0x00000FFF));
+	vni = br_vni_label(label);
 	err = br_set_trill_vni(argv[1], argv[2], vni);
-	printf("vni %i\n",vni);
-	printf("adding vni %i  to interface %s  %s\n",label,argv[2],
+	out_printf("vni %i\n",vni);
+	out_printf("adding vni %i  to interface %s  %s\n",label,argv[2],
 	       err == 0 ? "suceeded":"failed !!!\n------\
 	       \nvni could be applied only to existant guest vif\n------\n");
-	if (err)
+	if (err) {
+		out_flush();
 		fprintf(stderr, "error adding vni %i on interface %s \n",
 			label, argv[2]);
+	}
 	return err != 0;
 }
 
@@ -345,60 +349,163 @@ static int br_cmd_delvni(int argc, char* const* argv)
 {
 	int err;
 	err = br_set_trill_vni(argv[1],argv[2],0);
-	printf("delting vni from interface %s  %s\n", argv[2],
+	out_printf("delting vni from interface %s  %s\n", argv[2],
 	       err == 0 ? "suceeded":"failed !!!\n------\
 	       \nvni could be applied only to existant guest vif\
 	       \n------\n");
 	return err!=0;
 }
 
-static int br_cmd_showstp(int argc, char *const* argv)
+/*
+ * "port vni" lines of a file, '#' starting a comment.
+ * All are checked before any is applied.
+ */
+static int br_cmd_setvni_bulk(int argc, char *const* argv)
 {
-	struct bridge_info info;
-
-	if (br_get_bridge_info(argv[1], &info)) {
-		fprintf(stderr, "%s: can't get info %s\n", argv[1],
-			strerror(errno));
+	const char *brname = argv[1], *name = argv[2];
+	struct br_port_vni *pv = NULL, *more;
+	char *line = NULL, *cp, *port, *vni, *end;
+	size_t len = 0;
+	int i, n = 0, size = 0, lineno = 0, errors = 0, failed = 0;
+	long label;
+	FILE *f;
+
+	if (strcmp(name, "-") == 0)
+		f = stdin;
+	else if ((f = fopen(name, "r")) == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", name, strerror(errno));
 		return 1;
 	}
 
-	br_dump_info(argv[1], &info);
-	return 0;
+	while (getline(&line, &len, f) != -1) {
+		++lineno;
+		if ((cp = strchr(line, '#')) != NULL)
+			*cp = '\0';
+
+		port = strtok(line, " \t\r\n");
+		if (!port)
+			continue;
+		vni = strtok(NULL, " \t\r\n");
+		label = vni ? strtol(vni, &end, 0) : -1;
+		if (!vni || *end || strtok(NULL, " \t\r\n")
+		    || label < 0 || label > 16777215) {
+			fprintf(stderr, "%s:%d: expected <port> <vni>, "
+				"vni in [0..16777215]\n", name, lineno);
+			++errors;
+			continue;
+		}
+
+		if (n == size) {
+			size = size ? 2 * size : 256;
+			more = realloc(pv, size * sizeof(*pv));
+			if (!more) {
+				failed = 1;
+				break;
+			}
+			pv = more;
+		}
+		pv[n].port = strdup(port);
+		if (!pv[n].port) {
+			failed = 1;
+			break;
+		}
+		pv[n].vni = br_vni_label(label);
+		++n;
+	}
+	free(line);
+	if (f != stdin)
+		fclose(f);
+
+	if (failed) {
+		fprintf(stderr, "Out of memory\n");
+		goto out;
+	}
+	if (errors) {
+		fprintf(stderr, "%d bad lines, no vni set\n", errors);
+		failed = 1;
+		goto out;
+	}
+
+	failed = br_set_trill_vnis(brname, pv, n);
+	if (failed < 0) {
+		fprintf(stderr, "can't get ports of %s: %s\n", brname,
+			strerror(-failed));
+		goto out;
+	}
+
+	out_flush();
+	for (i = 0; i < n; i++)
+		if (pv[i].error)
+			fprintf(stderr, "%s: can't set vni: %s\n", pv[i].port,
+				strerror(pv[i].error));
+	out_printf("vni set on %d of %d ports of %s\n", n - failed, n, brname);
+
+out:
+	for (i = 0; i < n; i++)
+		free((char *) pv[i].port);
+	free(pv);
+	return failed != 0;
 }
 
-static int show_bridge(const char *name, void *arg)
+static int br_cmd_showstp(int argc, char *const* argv)
 {
-	struct bridge_info info;
+	struct br_snapshot *snap;
+	const char *brname = argv[1];
+	int err;
 
-	printf("%s\t\t", name);
-	fflush(stdout);
+	if (strcmp(brname, "all") == 0)
+		brname = NULL;
 
-	if (br_get_bridge_info(name, &info)) {
-		fprintf(stderr, "can't get info %s\n",
-				strerror(errno));
+	snap = br_snapshot_take_threads(brname, BR_INFO_ALL, BR_PORT_ALL,
+					BR_SNAPSHOT_PORTS, jobs);
+	if (!snap) {
+		fprintf(stderr, "%s: can't get info %s\n", argv[1],
+			strerror(errno));
 		return 1;
 	}
 
-	br_dump_bridge_id((unsigned char *)&info.bridge_id);
-	printf("\t%s\t", info.stp_enabled?"yes":"no");
-	printf("%s\t", info.trill_enabled?"yes":"no");
-
-
-	br_dump_interface_list(name);
-	return 0;
+	err = br_dump_stp(snap, snap->bridges, snap->nbridges);
+	br_snapshot_free(snap);
+	return err != 0;
 }
 
+#define SHOW_INFO	(BR_INFO_BRIDGE_ID | BR_INFO_STP_ENABLED \
+			 | BR_INFO_TRILL_ENABLED)
+
 static int br_cmd_show(int argc, char *const* argv)
 {
+	struct br_snapshot *snap;
 	int i;
 
-	printf("bridge name\tbridge id\t\tSTP\tTRILL\tinterfaces\n");
-	if (argc == 1)
-		br_foreach_bridge(show_bridge, NULL);
-	else
-		for(i = 2; i <= argc; i++)
-			show_bridge(argv[i - 1], NULL);
+	br_dump_bridge_header();
 
+	if (argc == 1) {
+		snap = br_snapshot_take_threads(NULL, SHOW_INFO, 0,
+						BR_SNAPSHOT_PORTS, jobs);
+		if (!snap) {
+			fprintf(stderr, "can't get bridges: %s\n",
+				strerror(errno));
+			br_dump_bridge_footer();
+			return 1;
+		}
+
+		for (i = 0; i < snap->nbridges; i++)
+			if (br_dump_bridge(snap, snap->bridges + i))
+				break;
+		br_snapshot_free(snap);
+	} else
+		for(i = 2; i <= argc; i++) {
+			snap = br_snapshot_take(argv[i - 1], SHOW_INFO, 0,
+						BR_SNAPSHOT_PORTS);
+			if (!snap) {
+				br_dump_bridge_error(argv[i - 1], errno);
+				continue;
+			}
+			br_dump_bridge(snap, snap->bridges);
+			br_snapshot_free(snap);
+		}
+
+	br_dump_bridge_footer();
 	return 0;
 }
 
@@ -410,90 +517,594 @@ static int compare_fdbs(const void *_f0, const void *_f1)
 	return memcmp(f0->mac_addr, f1->mac_addr, 6);
 }
 
-static int br_cmd_showmacs(int argc, char *const* argv)
+/* say if a read of the table failed or took more than one read */
+static void report_fdb_read(const char *brname, int n, int retries)
 {
-	const char *brname = argv[1];
-#define CHUNK 128
-	int i, n;
-	struct fdb_entry *fdb = NULL;
-	int offset = 0;
-
-	for(;;) {
-		fdb = realloc(fdb, (offset + CHUNK) * sizeof(struct fdb_entry));
-		if (!fdb) {
-			fprintf(stderr, "Out of memory\n");
-			return 1;
+	out_flush();
+	if (n < 0)
+		fprintf(stderr, "read of forward table failed: %s\n",
+			strerror(-n));
+	else if (retries)
+		fprintf(stderr, "forward table of %s changed while read, "
+			"%d retries\n", brname, retries);
+}
+
+/* read the table at one moment */
+static int read_fdb_snapshot(const char *brname, struct fdb_entry **fdb)
+{
+	int n, retries;
+
+	n = br_fdb_snapshot(brname, fdb, &retries);
+	report_fdb_read(brname, n, retries);
+	return n;
+}
+
+/*
+ * Forwarding table keyed by mac address, for showmacs --watch.
+ * Open addressing with linear probing; never more than half full.
+ */
+struct mac_slot
+{
+	struct fdb_entry f;
+	unsigned char used;
+	unsigned char seen;
+};
+
+struct mac_table
+{
+	struct mac_slot *slots;
+	unsigned int mask;
+	int count;
+};
+
+static unsigned int mac_hash(const unsigned char *mac)
+{
+	unsigned long long key = 0;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		key = (key << 8) | mac[i];
+
+	return (key * 0x9E3779B97F4A7C15ULL) >> 32;
+}
+
+static struct mac_slot *mac_lookup(const struct mac_table *t,
+				   const unsigned char *mac)
+{
+	unsigned int i;
+
+	if (!t->slots)
+		return NULL;
+
+	for (i = mac_hash(mac) & t->mask; t->slots[i].used;
+	     i = (i + 1) & t->mask)
+		if (!memcmp(t->slots[i].f.mac_addr, mac, 6))
+			return t->slots + i;
+
+	return NULL;
+}
+
+static int mac_resize(struct mac_table *t, unsigned int size)
+{
+	struct mac_slot *old = t->slots;
+	unsigned int i, j, oldsize = old ? t->mask + 1 : 0;
+
+	t->slots = calloc(size, sizeof(struct mac_slot));
+	if (!t->slots) {
+		t->slots = old;
+		return -1;
+	}
+	t->mask = size - 1;
+
+	for (i = 0; i < oldsize; i++) {
+		if (!old[i].used)
+			continue;
+		for (j = mac_hash(old[i].f.mac_addr) & t->mask;
+		     t->slots[j].used; j = (j + 1) & t->mask)
+			;
+		t->slots[j] = old[i];
+	}
+	free(old);
+	return 0;
+}
+
+static struct mac_slot *mac_insert(struct mac_table *t,
+				   const struct fdb_entry *f)
+{
+	struct mac_slot *s;
+	unsigned int i;
+
+	if (!t->slots || 2 * (t->count + 1) > t->mask + 1) {
+		if (mac_resize(t, t->slots ? 2 * (t->mask + 1) : 1024))
+			return NULL;
+	}
+
+	for (i = mac_hash(f->mac_addr) & t->mask; t->slots[i].used;
+	     i = (i + 1) & t->mask) {
+		if (!memcmp(t->slots[i].f.mac_addr, f->mac_addr, 6))
+			break;
+	}
+
+	s = t->slots + i;
+	if (!s->used)
+		++t->count;
+	s->f = *f;
+	s->used = 1;
+	s->seen = 0;
+	return s;
+}
+
+static void mac_clear(struct mac_table *t)
+{
+	if (t->slots)
+		memset(t->slots, 0, (t->mask + 1) * sizeof(struct mac_slot));
+	t->count = 0;
+}
+
+static void show_mac_change(const char *what, const struct fdb_entry *f)
+{
+	out_str(what);
+	out_char('\t');
+	out_int(f->port_no, 3);
+	out_char('\t');
+	out_mac(f->mac_addr);
+	out_str(f->is_local ? "\tyes" : "\tno");
+}
+
+/* previous and current round of showmacs --watch */
+struct fdb_watch
+{
+	struct mac_table prev;
+	struct mac_table cur;
+	int nomem;
+};
+
+static int watch_fdb(const struct fdb_entry *f, void *arg)
+{
+	struct fdb_watch *w = arg;
+	struct mac_slot *p;
+
+	if (!mac_insert(&w->cur, f)) {
+		w->nomem = 1;
+		return 1;
+	}
+
+	p = mac_lookup(&w->prev, f->mac_addr);
+	if (!p) {
+		show_mac_change("added", f);
+		out_char('\n');
+	} else {
+		p->seen = 1;
+		if (p->f.port_no != f->port_no) {
+			show_mac_change("moved", f);
+			out_str("\t(from ");
+			out_int(p->f.port_no, 0);
+			out_str(")\n");
 		}
-			
-		n = br_read_fdb(brname, fdb+offset, offset, CHUNK);
-		if (n == 0)
+	}
+
+	return 0;
+}
+
+/*
+ * Print the forwarding table entries added, removed or moved to
+ * another port since the previous read, every interval seconds.
+ */
+static int watch_macs(const char *brname, const struct timespec *interval)
+{
+	struct fdb_watch w;
+	struct mac_table tmp;
+	struct fdb_entry *fdb;
+	unsigned int i;
+	int n;
+
+	memset(&w, 0, sizeof(w));
+
+	for (;;) {
+		mac_clear(&w.cur);
+		n = read_fdb_snapshot(brname, &fdb);
+		if (n < 0)
 			break;
+		for (i = 0; i < (unsigned int) n; i++)
+			if (watch_fdb(fdb + i, &w))
+				break;
+		free(fdb);
+		if (w.nomem) {
+			out_flush();
+			fprintf(stderr, "Out of memory\n");
+			break;
+		}
 
-		if (n < 0) {
-			fprintf(stderr, "read of forward table failed: %s\n",
-				strerror(errno));
+		for (i = 0; w.prev.slots && i <= w.prev.mask; i++) {
+			const struct mac_slot *s = w.prev.slots + i;
+
+			if (s->used && !s->seen) {
+				show_mac_change("removed", &s->f);
+				out_char('\n');
+			}
+		}
+		out_flush();
+
+		tmp = w.prev;
+		w.prev = w.cur;
+		w.cur = tmp;
+
+		nanosleep(interval, NULL);
+	}
+
+	free(w.prev.slots);
+	free(w.cur.slots);
+	return 1;
+}
+
+static int br_cmd_showmacs(int argc, char *const* argv)
+{
+	const char *brname = NULL;
+	struct fdb_entry *fdb;
+	struct timespec interval;
+	double secs = 0;
+	int i, offset;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--watch") || !strcmp(argv[i], "-w")) {
+			if (++i == argc || sscanf(argv[i], "%lf", &secs) != 1
+			    || secs <= 0) {
+				fprintf(stderr, "bad watch interval\n");
+				return 1;
+			}
+		} else if (!brname)
+			brname = argv[i];
+		else {
+			fprintf(stderr, "unexpected argument %s\n", argv[i]);
 			return 1;
 		}
+	}
+	if (!brname) {
+		fprintf(stderr, "no bridge given\n");
+		return 1;
+	}
 
-		offset += n;
+	if (secs > 0) {
+		interval.tv_sec = secs;
+		interval.tv_nsec = 1e9 * (secs - interval.tv_sec);
+		return watch_macs(brname, &interval);
 	}
 
-	qsort(fdb, offset, sizeof(struct fdb_entry), compare_fdbs);
+	offset = read_fdb_snapshot(brname, &fdb);
+	if (offset < 0)
+		return 1;
+
+	if (sort_fdbs(fdb, offset, sizeof(struct fdb_entry)))
+		qsort(fdb, offset, sizeof(struct fdb_entry), compare_fdbs);
 
-	printf("port no\tmac addr\t\tis local?\tageing timer\n");
+	br_dump_fdb_header(0);
 	for (i = 0; i < offset; i++) {
 		const struct fdb_entry *f = fdb + i;
-		printf("%3i\t", f->port_no);
-		printf("%.2x:%.2x:%.2x:%.2x:%.2x:%.2x\t",
-		       f->mac_addr[0], f->mac_addr[1], f->mac_addr[2],
-		       f->mac_addr[3], f->mac_addr[4], f->mac_addr[5]);
-		printf("%s\t\t", f->is_local?"yes":"no");
-		br_show_timer(&f->ageing_timer_value);
-		printf("\n");
+		br_dump_fdb(f->mac_addr, f->port_no, -1, f->is_local,
+			 &f->ageing_timer_value);
 	}
+	br_dump_fdb_footer();
+	free(fdb);
 	return 0;
 }
 
-static int br_cmd_showmacs_nick(int argc, char *const* argv)
+/* where findmac looks, and what it found */
+struct mac_search
+{
+	unsigned char mac[6];
+	const char *port;	/* name of port port_no, once found */
+	unsigned port_no;
+	int found;
+	int errors;
+};
+
+static int find_port_name(const char *br, const char *port, void *arg)
+{
+	struct mac_search *ms = arg;
+	struct port_info pinfo;
+
+	if (br_get_port_info_mask(br, port, BR_PORT_NO, &pinfo)
+	    || pinfo.port_no != ms->port_no)
+		return 0;
+
+	ms->port = strdup(port);
+	return 1;
+}
+
+static int find_mac(const char *brname, void *arg)
+{
+	struct mac_search *ms = arg;
+	struct fdb_entry f;
+	int err;
+
+	err = br_fdb_lookup(brname, ms->mac, &f);
+	if (err == ENOENT)
+		return 0;
+	if (err) {
+		out_flush();
+		fprintf(stderr, "read of forward table of %s failed: %s\n",
+			brname, strerror(err));
+		++ms->errors;
+		return 0;
+	}
+
+	ms->port = NULL;
+	ms->port_no = f.port_no;
+	br_foreach_port(brname, find_port_name, ms);
+
+	if (!ms->found++)
+		out_str("bridge name\tport\tport no\tis local?\tageing timer\n");
+	out_printf("%s\t\t%s\t%3i\t%s\t\t", brname, ms->port ? ms->port : "-",
+		   f.port_no, f.is_local ? "yes" : "no");
+	out_timer(&f.ageing_timer_value);
+	out_char('\n');
+
+	free((char *) ms->port);
+	return 0;
+}
+
+static int br_cmd_findmac(int argc, char *const* argv)
 {
 	const char *brname = argv[1];
-	#define CHUNK 128
-	int i, n;
-	struct fdb_entry_nick *fdb = NULL;
-	int offset = 0;
-	char nick[6];
-	for(;;) {
-		fdb = realloc(fdb, (offset + CHUNK) * sizeof(struct fdb_entry_nick));
-		if (!fdb) {
-			fprintf(stderr, "Out of memory\n");
+	struct mac_search ms;
+	unsigned char *m = ms.mac;
+	char c;
+
+	memset(&ms, 0, sizeof(ms));
+	if (sscanf(argv[2], "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx%c",
+		   m, m + 1, m + 2, m + 3, m + 4, m + 5, &c) != 6) {
+		fprintf(stderr, "bad mac address %s\n", argv[2]);
+		return 1;
+	}
+
+	if (strcmp(brname, "all") == 0) {
+		int err = br_foreach_bridge(find_mac, &ms);
+
+		if (err < 0) {
+			fprintf(stderr, "can't get bridges: %s\n",
+				strerror(-err));
 			return 1;
 		}
-		n = br_read_fdb_nick(brname, fdb+offset, offset, CHUNK);
-		if (n == 0)
-			break;
-		if (n < 0) {
-			fprintf(stderr, "read of forward table failed: %s\n",
-				strerror(errno));
+	} else
+		find_mac(brname, &ms);
+
+	out_flush();
+	if (!ms.found && !ms.errors)
+		fprintf(stderr, "%s not found\n", argv[2]);
+
+	return !ms.found;
+}
+
+static const int age_limits[BR_FDB_AGE_BUCKETS - 1] = BR_FDB_AGE_LIMITS;
+
+static const char *port_name(const struct br_snapshot *snap, unsigned port_no)
+{
+	int i;
+
+	for (i = 0; snap && i < snap->nports; i++)
+		if (!snap->ports[i].error
+		    && snap->ports[i].info.port_no == port_no)
+			return snap->ports[i].name;
+	return "-";
+}
+
+/* a row per port, then the total row (is_total) for the bridge */
+static void show_fdb_stats(const char *name, const struct br_fdb_port_stats *ps,
+			   int is_total)
+{
+	int i;
+
+	if (format == FORMAT_JSON) {
+		if (!is_total) {
+			json_open(NULL, '{');
+			json_int("port_no", ps->port_no);
+			json_str("port", name);
+		}
+		json_int("total", ps->total);
+		json_int("local", ps->local);
+		json_open("age", '[');
+		for (i = 0; i < BR_FDB_AGE_BUCKETS; i++)
+			json_int(NULL, ps->age[i]);
+		json_close(']');
+		if (!is_total)
+			json_close('}');
+		return;
+	}
+
+	if (format == FORMAT_TSV) {
+		out_int(ps->port_no, 0);
+		out_char('\t');
+		out_tsv_str(name);
+		out_char('\t');
+	} else {
+		if (!is_total)
+			out_int(ps->port_no, 3);
+		out_char('\t');
+		out_str(name);
+		out_str(strlen(name) < 8 ? "\t\t" : "\t");
+	}
+
+	out_int(ps->total, 0);
+	out_char('\t');
+	out_int(ps->local, 0);
+	for (i = 0; i < BR_FDB_AGE_BUCKETS; i++) {
+		out_char('\t');
+		out_int(ps->age[i], 0);
+	}
+	out_char('\n');
+}
+
+static int br_cmd_fdbstats(int argc, char *const* argv)
+{
+	const char *brname = argv[1];
+	struct br_snapshot *snap;
+	struct br_fdb_stats st;
+	int i, err;
+
+	err = br_fdb_stats(brname, &st);
+	if (err) {
+		fprintf(stderr, "read of forward table failed: %s\n",
+			strerror(err));
+		return 1;
+	}
+
+	/* without names the port numbers still tell */
+	snap = br_snapshot_take(brname, 0, BR_PORT_NO, BR_SNAPSHOT_PORTS);
+
+	if (format == FORMAT_JSON) {
+		json_open(NULL, '{');
+		json_str("bridge", brname);
+		json_open("age_limits", '[');
+		for (i = 0; i < BR_FDB_AGE_BUCKETS - 1; i++)
+			json_int(NULL, age_limits[i]);
+		json_close(']');
+		show_fdb_stats(NULL, &st.all, 1);
+		json_open("ports", '[');
+	} else {
+		out_str(format == FORMAT_TSV ? "#port_no\tport\ttotal\tlocal"
+			: "port no\tport\t\ttotal\tlocal");
+		for (i = 0; i < BR_FDB_AGE_BUCKETS - 1; i++)
+			out_printf("\t<%d", age_limits[i]);
+		out_printf("\t>=%d\n", age_limits[i - 1]);
+	}
+
+	for (i = 0; i < st.nports; i++)
+		show_fdb_stats(port_name(snap, st.ports[i].port_no),
+			       st.ports + i, 0);
+
+	if (format == FORMAT_JSON) {
+		json_close(']');
+		json_close('}');
+	} else if (format == FORMAT_TEXT)
+		show_fdb_stats("total", &st.all, 1);
+
+	br_snapshot_free(snap);
+	br_fdb_stats_free(&st);
+	return 0;
+}
+
+struct nick_fdbs {
+	struct fdb_entry_nick *ents;
+	int count;
+	int size;
+	int nomem;
+};
+
+static int keep_fdb_nick(const struct fdb_entry_nick *f, void *arg)
+{
+	struct nick_fdbs *nf = arg;
+
+	if (nf->count == nf->size) {
+		int size = nf->size ? 2 * nf->size : 128;
+		struct fdb_entry_nick *ents;
+
+		ents = realloc(nf->ents, size * sizeof(*ents));
+		if (!ents) {
+			nf->nomem = 1;
 			return 1;
 		}
-		offset += n;
+		nf->ents = ents;
+		nf->size = size;
 	}
-	qsort(fdb, offset, sizeof(struct fdb_entry_nick), compare_fdbs);
-	printf("port no\tmac addr\t\tnick\t\tis local?\tageing timer\n");
-	for (i = 0; i < offset; i++) {
-		const struct fdb_entry_nick *f = fdb + i;
-		sprintf(nick,"%d",f->nick);
-		if(f->nick) {
-			printf("%3i\t", f->port_no);
-			printf("%.2x:%.2x:%.2x:%.2x:%.2x:%.2x\t",
-			       f->mac_addr[0], f->mac_addr[1], f->mac_addr[2],
-			       f->mac_addr[3], f->mac_addr[4], f->mac_addr[5]);
-			printf("%s\t\t",f->nick ? nick :"no");
-			printf("%s\t\t", f->is_local?"yes":"no");
-			br_show_timer(&f->ageing_timer_value);
-			printf("\n");
+	nf->ents[nf->count++] = *f;
+	return 0;
+}
+
+/* A TRILL nickname, 1 to 65535. Returns it, or -1 */
+static int parse_nick(const char *arg)
+{
+	char *end;
+	long nick;
+
+	nick = strtol(arg, &end, 0);
+	if (*arg == '\0' || *end != '\0' || nick < 1 || nick > 0xffff) {
+		fprintf(stderr, "bad nickname %s\n", arg);
+		return -1;
+	}
+	return nick;
+}
+
+static int br_cmd_showmacs_nick(int argc, char *const* argv)
+{
+	const char *brname = argv[1];
+	struct nick_fdbs nf = { NULL, 0, 0, 0 };
+	int i, n, retries = 0, nick = BR_NICK_ANY;
+
+	if (argc > 2 && (nick = parse_nick(argv[2])) < 0)
+		return 1;
+
+	/* only the entries that will be shown are kept and sorted */
+	while ((n = br_foreach_fdb_nick(brname, nick, keep_fdb_nick, &nf))
+	       == -EAGAIN && ++retries < BR_DUMP_TRIES) {
+		nf.count = 0;
+		br_backoff(retries - 1);
+	}
+	report_fdb_read(brname, n, retries);
+	if (n < 0) {
+		free(nf.ents);
+		return 1;
+	}
+	if (nf.nomem) {
+		fprintf(stderr, "Out of memory\n");
+		free(nf.ents);
+		return 1;
+	}
+
+	if (sort_fdbs(nf.ents, nf.count, sizeof(struct fdb_entry_nick)))
+		qsort(nf.ents, nf.count, sizeof(struct fdb_entry_nick),
+		      compare_fdbs);
+	br_dump_fdb_header(1);
+	for (i = 0; i < nf.count; i++) {
+		const struct fdb_entry_nick *f = nf.ents + i;
+
+		br_dump_fdb(f->mac_addr, f->port_no, f->nick, f->is_local,
+			    &f->ageing_timer_value);
+	}
+	br_dump_fdb_footer();
+	free(nf.ents);
+	return 0;
+}
+
+static int br_cmd_shownicks(int argc, char *const* argv)
+{
+	const char *brname = argv[1];
+	struct br_nick_count *nicks = NULL;
+	int i, n, retries;
+
+	n = br_fdb_nicks(brname, &nicks, &retries);
+	report_fdb_read(brname, n, retries);
+	if (n < 0)
+		return 1;
+
+	if (format == FORMAT_JSON)
+		json_open(NULL, '[');
+	else if (format == FORMAT_TSV)
+		out_str("#nick\ttotal\tlocal\n");
+	else
+		out_str("nick\ttotal\tlocal\n");
+
+	for (i = 0; i < n; i++) {
+		const struct br_nick_count *nc = nicks + i;
+
+		if (format == FORMAT_JSON) {
+			json_open(NULL, '{');
+			json_int("nick", nc->nick);
+			json_int("total", nc->total);
+			json_int("local", nc->local);
+			json_close('}');
+		} else {
+			out_int(nc->nick, 0);
+			out_char('\t');
+			out_int(nc->total, 0);
+			out_char('\t');
+			out_int(nc->local, 0);
+			out_char('\n');
 		}
 	}
+
+	if (format == FORMAT_JSON)
+		json_close(']');
+	free(nicks);
 	return 0;
 }
 
@@ -514,11 +1125,11 @@ static int br_cmd_hairpin(int argc, char *const* argv)
 		fprintf(stderr, "expect on/off for argument\n");
 		return 1;
 	}
-	if (if_nametoindex(ifname) == 0) {
+	if (br_if_nametoindex(ifname) == 0) {
 		fprintf(stderr, "interface %s does not exist!\n",
 			ifname);
 		return 1;
-	} else if (if_nametoindex(brname) == 0) {
+	} else if (br_if_nametoindex(brname) == 0) {
 		fprintf(stderr, "bridge %s does not exist!\n",
 			brname);
 		return 1;
@@ -533,28 +1144,240 @@ static int br_cmd_hairpin(int argc, char *const* argv)
 	return err != 0;
 }
 
-static int br_cmd_showvs(int argc, char *const* argv)
+static int show_event(const struct br_event *ev, void *arg)
+{
+	out_printf("%ld.%06ld %s ", (long)ev->time.tv_sec,
+		   (long)ev->time.tv_usec, ev->bridge);
+	if (ev->port[0]) {
+		out_str(ev->port);
+		out_char(' ');
+	}
+
+	switch (ev->type) {
+	case BR_EVENT_BRIDGE_ADD:
+		out_str("bridge added\n");
+		break;
+	case BR_EVENT_BRIDGE_DEL:
+		out_str("bridge removed\n");
+		break;
+	case BR_EVENT_BRIDGE_CHANGE:
+		out_str("bridge changed\n");
+		break;
+	case BR_EVENT_PORT_ADD:
+		out_printf("port added (%s)\n", br_get_state_name(ev->state));
+		break;
+	case BR_EVENT_PORT_DEL:
+		out_str("port removed\n");
+		break;
+	case BR_EVENT_PORT_STATE:
+		out_printf("state %s -> %s\n", br_get_state_name(ev->old_state),
+			   br_get_state_name(ev->state));
+		break;
+	case BR_EVENT_FDB_ADD:
+	case BR_EVENT_FDB_DEL:
+		out_str(ev->type == BR_EVENT_FDB_ADD ? "fdb add " : "fdb del ");
+		out_mac(ev->fdb.mac_addr);
+		out_str(ev->fdb.is_local ? " local\n" : "\n");
+		break;
+	}
+
+	return 0;
+}
+
+static int br_cmd_monitor(int argc, char *const* argv)
+{
+	const char *brname = argc > 1 ? argv[1] : NULL;
+	struct br_monitor *m;
+	int n;
+
+	m = br_monitor_open(brname);
+	if (!m) {
+		if (errno == ENODEV)
+			fprintf(stderr, "bridge %s does not exist!\n", brname);
+		else
+			fprintf(stderr, "can't monitor bridges: %s\n",
+				strerror(errno));
+		return 1;
+	}
+
+	for (;;) {
+		n = br_monitor_dispatch(m, show_event, NULL);
+		if (n == -ENOBUFS) {
+			out_flush();
+			fprintf(stderr, "events lost, state read again\n");
+			continue;
+		}
+		if (n < 0 && n != -EINTR) {
+			out_flush();
+			fprintf(stderr, "monitor failed: %s\n", strerror(-n));
+			break;
+		}
+		out_flush();
+	}
+
+	br_monitor_close(m);
+	return 1;
+}
+
+static int set_port_vni(const char *bridge, const char *port, int label)
+{
+	return br_set_trill_vni(bridge, port, br_vni_label(label));
+}
+
+/* setport keys, applied in this order */
+static const struct port_key {
+	const char *name;
+	int (*set)(const char *bridge, const char *port, int value);
+} port_keys[] = {
+	{ "pathcost", br_set_path_cost },
+	{ "prio", br_set_port_priority },
+	{ "hairpin", br_set_hairpin_mode },
+	{ "vni", set_port_vni },
+};
+
+#define NR_PORT_KEYS	(sizeof(port_keys)/sizeof(port_keys[0]))
+
+static int parse_port_setting(const char *arg, int *index, int *value)
+{
+	const char *eq = strchr(arg, '=');
+	int i;
+
+	if (!eq)
+		return -1;
+
+	for (i = 0; i < NR_PORT_KEYS; i++) {
+		if (strlen(port_keys[i].name) == eq - arg
+		    && !strncmp(arg, port_keys[i].name, eq - arg))
+			break;
+	}
+	if (i == NR_PORT_KEYS)
+		return -1;
+	*index = i;
+
+	if (port_keys[i].set == br_set_hairpin_mode) {
+		if (!strcmp(eq + 1, "on") || !strcmp(eq + 1, "yes")
+		    || !strcmp(eq + 1, "1"))
+			*value = 1;
+		else if (!strcmp(eq + 1, "off") || !strcmp(eq + 1, "no")
+			 || !strcmp(eq + 1, "0"))
+			*value = 0;
+		else
+			return -1;
+		return 0;
+	}
+
+	if (sscanf(eq + 1, "%i", value) != 1)
+		return -1;
+
+	/* vni=0 removes the port from its virtual network */
+	if (port_keys[i].set == set_port_vni
+	    && (*value < 0 || *value > 16777215))
+		return -1;
+
+	return 0;
+}
+
+struct port_match
+{
+	const char *pattern;
+	char (*names)[IFNAMSIZ];
+	int count;
+	int size;
+};
+
+static int match_port(const char *br, const char *port, void *arg)
+{
+	struct port_match *m = arg;
+
+	if (strcmp(m->pattern, "all") && fnmatch(m->pattern, port, 0))
+		return 0;
+
+	if (m->count == m->size) {
+		int size = m->size ? 2 * m->size : 64;
+		void *names = realloc(m->names, size * IFNAMSIZ);
+
+		if (!names)
+			return 1;
+		m->names = names;
+		m->size = size;
+	}
+
+	strncpy(m->names[m->count], port, IFNAMSIZ - 1);
+	m->names[m->count][IFNAMSIZ - 1] = '\0';
+	++m->count;
+	return 0;
+}
+
+static int br_cmd_setport(int argc, char *const* argv)
 {
 	const char *brname = argv[1];
-	u_int32_t ifindex[MAX_PORTS];
-	int i, ret;
-	char ifname[IFNAMSIZ];
-	ret = vs_get_port_list(brname, ifindex);
-	ret = ret < MAX_PORTS ? ret : MAX_PORTS;
-	for (i = 0; i < ret; i++) {
-		printf("--------------- \nvni\t%i\ninterfaces:\n",
-		       (((ifindex[i]&0x0FFF0000) >>4 )|(ifindex[i]&0x00000FFF)));
-		i++;
-		while (ifindex[i] != VS_SEPARATOR) {
-			if(ifindex[i]) {
-				if_indextoname(ifindex[i], ifname);
-				printf("\t%s\n",ifname);
+	struct port_match m = { argv[2], NULL, 0, 0 };
+	int set[NR_PORT_KEYS], value[NR_PORT_KEYS];
+	int i, k, n, err, failed = 0;
+
+	memset(set, 0, sizeof(set));
+	for (i = 3; i < argc; i++) {
+		if (parse_port_setting(argv[i], &k, &n)) {
+			fprintf(stderr, "bad port setting %s\n", argv[i]);
+			return 1;
+		}
+		set[k] = 1;
+		value[k] = n;
+	}
+
+	err = br_foreach_port(brname, match_port, &m);
+	if (err < 0) {
+		fprintf(stderr, "can't get ports of %s: %s\n",
+			brname, strerror(-err));
+		free(m.names);
+		return 1;
+	}
+	if (m.count == 0) {
+		fprintf(stderr, "no port of bridge %s matches %s\n",
+			brname, m.pattern);
+		free(m.names);
+		return 1;
+	}
+
+	for (i = 0; i < m.count; i++) {
+		int port_failed = 0;
+
+		for (k = 0; k < NR_PORT_KEYS; k++) {
+			if (!set[k])
+				continue;
+
+			err = port_keys[k].set(brname, m.names[i], value[k]);
+			if (err) {
+				out_flush();
+				fprintf(stderr, "%s: can't set %s: %s\n",
+					m.names[i], port_keys[k].name,
+					strerror(err));
+				port_failed = 1;
 			}
-			i++;
 		}
+		failed += port_failed;
+	}
+
+	out_flush();
+	if (failed)
+		fprintf(stderr, "setport failed on %d of %d ports\n",
+			failed, m.count);
+
+	free(m.names);
+	return failed != 0;
+}
+
+static int br_cmd_showvs(int argc, char *const* argv)
+{
+	struct br_vni_table *t = br_vni_table_get(argv[1]);
+
+	if (!t) {
+		fprintf(stderr, "can't get virtual networks of %s: %s\n",
+			argv[1], strerror(errno));
+		return 1;
 	}
-	if(ret > 0)
-		printf("--------------- \n");
+	br_dump_vs(t);
+	br_vni_table_free(t);
 	return 0;
 }
 
@@ -565,6 +1388,10 @@ static const struct command commands[] = {
 	  "<bridge> <device>\tadd interface to bridge" },
 	{ 2, "delif", br_cmd_delif,
 	  "<bridge> <device>\tdelete interface from bridge" },
+	{ 0, "monitor", br_cmd_monitor,
+	  "[ <bridge> ]\t\tprint port, stp and fdb changes" },
+	{ 2, "findmac", br_cmd_findmac,
+	  "<bridge|all> <mac>\tshow where a mac addr was learned" },
 	{ 3, "hairpin", br_cmd_hairpin,
 	  "<bridge> <port> {on|off}\tturn hairpin on/off" },
 	{ 2, "setageing", br_cmd_setageing,
@@ -581,20 +1408,30 @@ static const struct command commands[] = {
 	  "<bridge> <port> <cost>\tset path cost" },
 	{ 3, "setportprio", br_cmd_setportprio,
 	  "<bridge> <port> <prio>\tset port priority" },
+	{ 3, "setport", br_cmd_setport,
+	  "<bridge> <port|glob|all> key=value...\n"
+	  "\t\t\tset pathcost, prio, hairpin and vni of ports" },
 	{ 0, "show", br_cmd_show,
 	  "[ <bridge> ]\t\tshow a list of bridges" },
 	{ 1, "showmacs", br_cmd_showmacs, 
-	  "<bridge>\t\tshow a list of mac addrs"},
+	  "<bridge> [--watch <interval>]\n"
+	  "\t\t\tshow a list of mac addrs, or their changes"},
+	{ 1, "fdbstats", br_cmd_fdbstats,
+	  "<bridge>\t\tcount mac addrs per port and ageing timer"},
 	{ 1, "showmacs_nick", br_cmd_showmacs_nick,
-	  "<bridge>\t\tshow a list of mac addrs and correspondant nick"},
+	  "<bridge> [<nick>]\tshow a list of mac addrs and correspondant nick"},
+	{ 1, "shownicks", br_cmd_shownicks,
+	  "<bridge>\t\tcount mac addrs per nick"},
 	{ 1, "showstp", br_cmd_showstp, 
-	  "<bridge>\t\tshow bridge stp info"},
+	  "<bridge|all>\t\tshow bridge stp info"},
 	{ 2, "stp", br_cmd_stp,
 	  "<bridge> {on|off}\tturn stp on/off" },
 	{ 2, "trill", br_cmd_trill,
 	  "<bridge> {on|off}\tturn trill on/off" },
 	{ 3, "setvni",br_cmd_setvni,
 	  "<bridge> <port> <vni> \tset virtual network id" },
+	{ 2, "setvni-bulk", br_cmd_setvni_bulk,
+	  "<bridge> <file|->\tset vnis from \"port vni\" lines" },
 	{ 2, "delvni", br_cmd_delvni,
 	  "<bridge> <port> \tdel virtual network id" },
 	{ 1, "showvs", br_cmd_showvs,
@@ -618,6 +1455,6 @@ void command_helpall(void)
 	int i;
 
 	for (i = 0; i < sizeof(commands)/sizeof(commands[0]); i++) {
-		printf("\t%-10s\t%s\n", commands[i].name, commands[i].help);
+		out_printf("\t%-10s\t%s\n", commands[i].name, commands[i].help);
 	}
 }
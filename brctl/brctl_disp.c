@@ -24,125 +24,593 @@
 #include "libbridge.h"
 #include "brctl.h"
 
-void br_dump_bridge_id(const unsigned char *x)
+void br_dump_interface_list(const struct br_snapshot *snap,
+			    const struct br_snapshot_bridge *b)
 {
-	printf("%.2x%.2x.%.2x%.2x%.2x%.2x%.2x%.2x", x[0], x[1], x[2], x[3],
-	       x[4], x[5], x[6], x[7]);
+	int i;
+
+	if (b->port_error) {
+		out_str(" can't get port info: ");
+		out_str(strerror(b->port_error));
+		out_char('\n');
+		return;
+	}
+
+	for (i = 0; i < b->nports; i++) {
+		if (i)
+			out_str("\n\t\t\t\t\t\t\t");
+		out_str(snap->ports[b->first_port + i].name);
+	}
+	out_char('\n');
 }
 
-void br_show_timer(const struct timeval *tv)
+static int dump_port_info(const struct br_snapshot_port *p)
 {
-	printf("%4i.%.2i", (int)tv->tv_sec, (int)tv->tv_usec/10000);
+	const struct port_info *pinfo = &p->info;
+
+	if (p->error) {
+		out_str("Can't get info for ");
+		out_str(p->name);
+		return 1;
+	}
+
+	out_str(p->name);
+	out_str(" (");
+	out_int(pinfo->port_no, 0);
+	out_str(")\n port id\t\t");
+	out_hex(pinfo->port_id, 4);
+	out_printf("\t\t\tstate\t\t%15s\n", br_get_state_name(pinfo->state));
+	out_str(" designated root\t");
+	out_bridge_id((unsigned char *)&pinfo->designated_root);
+	out_str("\tpath cost\t\t");
+	out_int(pinfo->path_cost, 4);
+
+	out_str("\n designated bridge\t");
+	out_bridge_id((unsigned char *)&pinfo->designated_bridge);
+	out_str("\tmessage age timer\t");
+	out_timer(&pinfo->message_age_timer_value);
+	out_str("\n designated port\t");
+	out_hex(pinfo->designated_port, 4);
+	out_str("\t\t\tforward delay timer\t");
+	out_timer(&pinfo->forward_delay_timer_value);
+	out_str("\n designated cost\t");
+	out_int(pinfo->designated_cost, 4);
+	out_str("\t\t\thold timer\t\t");
+	out_timer(&pinfo->hold_timer_value);
+	out_str("\n flags\t\t\t");
+	if (pinfo->config_pending)
+		out_str("CONFIG_PENDING ");
+	if (pinfo->top_change_ack)
+		out_str("TOPOLOGY_CHANGE_ACK ");
+	if (pinfo->hairpin_mode) {
+		out_str("\n hairpin mode\t\t");
+		out_int(pinfo->hairpin_mode, 4);
+	}
+	out_str("\n\n");
+	return 0;
+}
+
+void br_dump_info(const struct br_snapshot *snap,
+		  const struct br_snapshot_bridge *b)
+{
+	const struct bridge_info *bri = &b->info;
+	int i;
+
+	out_str(b->name);
+	out_str("\n bridge id\t\t");
+	out_bridge_id((unsigned char *)&bri->bridge_id);
+	out_str("\n designated root\t");
+	out_bridge_id((unsigned char *)&bri->designated_root);
+	out_str("\n root port\t\t");
+	out_int(bri->root_port, 4);
+	out_str("\t\t\tpath cost\t\t");
+	out_int(bri->root_path_cost, 4);
+	out_str("\n max age\t\t");
+	out_timer(&bri->max_age);
+	out_str("\t\t\tbridge max age\t\t");
+	out_timer(&bri->bridge_max_age);
+	out_str("\n hello time\t\t");
+	out_timer(&bri->hello_time);
+	out_str("\t\t\tbridge hello time\t");
+	out_timer(&bri->bridge_hello_time);
+	out_str("\n forward delay\t\t");
+	out_timer(&bri->forward_delay);
+	out_str("\t\t\tbridge forward delay\t");
+	out_timer(&bri->bridge_forward_delay);
+	out_str("\n ageing time\t\t");
+	out_timer(&bri->ageing_time);
+	out_str("\n hello timer\t\t");
+	out_timer(&bri->hello_timer_value);
+	out_str("\t\t\ttcn timer\t\t");
+	out_timer(&bri->tcn_timer_value);
+	out_str("\n topology change timer\t");
+	out_timer(&bri->topology_change_timer_value);
+	out_str("\t\t\tgc timer\t\t");
+	out_timer(&bri->gc_timer_value);
+	out_str("\n flags\t\t\t");
+	if (bri->topology_change)
+		out_str("TOPOLOGY_CHANGE ");
+	if (bri->topology_change_detected)
+		out_str("TOPOLOGY_CHANGE_DETECTED ");
+	out_str("\n\n\n");
+
+	if (b->port_error) {
+		out_str("can't get ports: ");
+		out_str(strerror(b->port_error));
+		out_char('\n');
+		return;
+	}
+
+	for (i = 0; i < b->nports; i++) {
+		if (dump_port_info(snap->ports + b->first_port + i))
+			break;
+	}
 }
 
-static int first;
+static void dump_port_json(const struct br_snapshot_port *p)
+{
+	const struct port_info *pinfo = &p->info;
 
-static int dump_interface(const char *b, const char *p, void *arg)
+	json_open(NULL, '{');
+	json_str("name", p->name);
+	if (p->error) {
+		json_str("error", strerror(p->error));
+		json_close('}');
+		return;
+	}
+
+	json_int("port_no", pinfo->port_no);
+	json_hex("port_id", pinfo->port_id, 4);
+	json_str("state", br_get_state_name(pinfo->state));
+	json_bridge_id("designated_root",
+		       (unsigned char *)&pinfo->designated_root);
+	json_int("path_cost", pinfo->path_cost);
+	json_bridge_id("designated_bridge",
+		       (unsigned char *)&pinfo->designated_bridge);
+	json_timer("message_age_timer", &pinfo->message_age_timer_value);
+	json_hex("designated_port", pinfo->designated_port, 4);
+	json_timer("forward_delay_timer", &pinfo->forward_delay_timer_value);
+	json_int("designated_cost", pinfo->designated_cost);
+	json_timer("hold_timer", &pinfo->hold_timer_value);
+	json_bool("config_pending", pinfo->config_pending);
+	json_bool("topology_change_ack", pinfo->top_change_ack);
+	json_int("hairpin_mode", pinfo->hairpin_mode);
+	json_close('}');
+}
+
+/* showstp --format=json: one object per bridge */
+void br_dump_info_json(const struct br_snapshot *snap,
+		       const struct br_snapshot_bridge *b)
 {
+	const struct bridge_info *bri = &b->info;
+	int i;
 
-	if (first) 
-		first = 0;
-	else
-		printf("\n\t\t\t\t\t\t\t");
+	json_open(NULL, '{');
+	json_str("name", b->name);
+	if (b->error) {
+		json_str("error", strerror(b->error));
+		json_close('}');
+		return;
+	}
 
-	printf("%s", p);
+	json_bridge_id("bridge_id", (unsigned char *)&bri->bridge_id);
+	json_bridge_id("designated_root",
+		       (unsigned char *)&bri->designated_root);
+	json_int("root_port", bri->root_port);
+	json_int("root_path_cost", bri->root_path_cost);
+	json_timer("max_age", &bri->max_age);
+	json_timer("bridge_max_age", &bri->bridge_max_age);
+	json_timer("hello_time", &bri->hello_time);
+	json_timer("bridge_hello_time", &bri->bridge_hello_time);
+	json_timer("forward_delay", &bri->forward_delay);
+	json_timer("bridge_forward_delay", &bri->bridge_forward_delay);
+	json_timer("ageing_time", &bri->ageing_time);
+	json_timer("hello_timer", &bri->hello_timer_value);
+	json_timer("tcn_timer", &bri->tcn_timer_value);
+	json_timer("topology_change_timer",
+		   &bri->topology_change_timer_value);
+	json_timer("gc_timer", &bri->gc_timer_value);
+	json_bool("topology_change", bri->topology_change);
+	json_bool("topology_change_detected",
+		  bri->topology_change_detected);
 
-	return 0;
+	if (b->port_error)
+		json_str("ports_error", strerror(b->port_error));
+	else {
+		json_open("ports", '[');
+		for (i = 0; i < b->nports; i++)
+			dump_port_json(snap->ports + b->first_port + i);
+		json_close(']');
+	}
+	json_close('}');
 }
 
-void br_dump_interface_list(const char *br)
+static void tsv_bool(int value)
 {
-	int err;
+	out_str(value ? "\t1" : "\t0");
+}
+
+static void tsv_int(int value)
+{
+	out_char('\t');
+	out_int(value, 0);
+}
+
+static void tsv_timer(const struct timeval *tv)
+{
+	out_char('\t');
+	out_tsv_timer(tv);
+}
+
+static void tsv_bridge_id(const struct bridge_id *id)
+{
+	out_char('\t');
+	out_bridge_id((unsigned char *)id);
+}
+
+void br_dump_info_tsv_header(void)
+{
+	out_str("#bridge\tname\tbridge_id\tdesignated_root\troot_port"
+		"\troot_path_cost\tmax_age\tbridge_max_age\thello_time"
+		"\tbridge_hello_time\tforward_delay\tbridge_forward_delay"
+		"\tageing_time\thello_timer\ttcn_timer"
+		"\ttopology_change_timer\tgc_timer\ttopology_change"
+		"\ttopology_change_detected\n");
+	out_str("#port\tbridge\tname\tport_no\tport_id\tstate"
+		"\tdesignated_root\tpath_cost\tdesignated_bridge"
+		"\tmessage_age_timer\tdesignated_port\tforward_delay_timer"
+		"\tdesignated_cost\thold_timer\tconfig_pending"
+		"\ttopology_change_ack\thairpin_mode\n");
+}
+
+/* showstp --format=tsv: a bridge line, then a line per port */
+int br_dump_info_tsv(const struct br_snapshot *snap,
+		     const struct br_snapshot_bridge *b)
+{
+	const struct bridge_info *bri = &b->info;
+	int i, err = 0;
 
-	first = 1;
-	err = br_foreach_port(br, dump_interface, NULL);
-	if (err < 0)
-		printf(" can't get port info: %s\n", strerror(-err));
+	if (b->error) {
+		out_flush();
+		fprintf(stderr, "%s: can't get info %s\n", b->name,
+			strerror(b->error));
+		return 1;
+	}
+
+	out_str("bridge\t");
+	out_tsv_str(b->name);
+	tsv_bridge_id(&bri->bridge_id);
+	tsv_bridge_id(&bri->designated_root);
+	tsv_int(bri->root_port);
+	tsv_int(bri->root_path_cost);
+	tsv_timer(&bri->max_age);
+	tsv_timer(&bri->bridge_max_age);
+	tsv_timer(&bri->hello_time);
+	tsv_timer(&bri->bridge_hello_time);
+	tsv_timer(&bri->forward_delay);
+	tsv_timer(&bri->bridge_forward_delay);
+	tsv_timer(&bri->ageing_time);
+	tsv_timer(&bri->hello_timer_value);
+	tsv_timer(&bri->tcn_timer_value);
+	tsv_timer(&bri->topology_change_timer_value);
+	tsv_timer(&bri->gc_timer_value);
+	tsv_bool(bri->topology_change);
+	tsv_bool(bri->topology_change_detected);
+	out_char('\n');
+
+	if (b->port_error) {
+		out_flush();
+		fprintf(stderr, "%s: can't get ports: %s\n", b->name,
+			strerror(b->port_error));
+		return 1;
+	}
+
+	for (i = 0; i < b->nports; i++) {
+		const struct br_snapshot_port *p = snap->ports
+			+ b->first_port + i;
+		const struct port_info *pinfo = &p->info;
+
+		if (p->error) {
+			out_flush();
+			fprintf(stderr, "Can't get info for %s\n", p->name);
+			err = 1;
+			continue;
+		}
+
+		out_str("port\t");
+		out_tsv_str(b->name);
+		out_char('\t');
+		out_tsv_str(p->name);
+		tsv_int(pinfo->port_no);
+		out_char('\t');
+		out_hex(pinfo->port_id, 4);
+		out_char('\t');
+		out_str(br_get_state_name(pinfo->state));
+		tsv_bridge_id(&pinfo->designated_root);
+		tsv_int(pinfo->path_cost);
+		tsv_bridge_id(&pinfo->designated_bridge);
+		tsv_timer(&pinfo->message_age_timer_value);
+		out_char('\t');
+		out_hex(pinfo->designated_port, 4);
+		tsv_timer(&pinfo->forward_delay_timer_value);
+		tsv_int(pinfo->designated_cost);
+		tsv_timer(&pinfo->hold_timer_value);
+		tsv_bool(pinfo->config_pending);
+		tsv_bool(pinfo->top_change_ack);
+		tsv_int(pinfo->hairpin_mode);
+		out_char('\n');
+	}
+
+	return err;
+}
+
+/* show --format=json: name, id, stp, trill and ports of a bridge */
+void br_dump_bridge_json(const struct br_snapshot *snap,
+			 const struct br_snapshot_bridge *b)
+{
+	int i;
+
+	json_open(NULL, '{');
+	json_str("name", b->name);
+	if (b->error)
+		json_str("error", strerror(b->error));
+	else {
+		json_bridge_id("bridge_id",
+			       (unsigned char *)&b->info.bridge_id);
+		json_bool("stp", b->info.stp_enabled);
+		json_bool("trill", b->info.trill_enabled);
+		if (b->port_error)
+			json_str("ports_error", strerror(b->port_error));
+		else {
+			json_open("interfaces", '[');
+			for (i = 0; i < b->nports; i++)
+				json_str(NULL,
+					 snap->ports[b->first_port + i].name);
+			json_close(']');
+		}
+	}
+	json_close('}');
+}
+
+/* show --format=tsv; interfaces are separated by commas */
+int br_dump_bridge_tsv(const struct br_snapshot *snap,
+		       const struct br_snapshot_bridge *b)
+{
+	int i;
+
+	if (b->error) {
+		out_flush();
+		fprintf(stderr, "%s: can't get info %s\n", b->name,
+			strerror(b->error));
+		return 1;
+	}
+
+	out_tsv_str(b->name);
+	tsv_bridge_id(&b->info.bridge_id);
+	tsv_bool(b->info.stp_enabled);
+	tsv_bool(b->info.trill_enabled);
+	out_char('\t');
+	for (i = 0; !b->port_error && i < b->nports; i++) {
+		if (i)
+			out_char(',');
+		out_tsv_str(snap->ports[b->first_port + i].name);
+	}
+	out_char('\n');
+
+	if (b->port_error) {
+		out_flush();
+		fprintf(stderr, "%s: can't get ports: %s\n", b->name,
+			strerror(b->port_error));
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * The rest is what the show commands print around the dumps
+ * above, shared by brctl and brstatd.
+ */
+
+void br_dump_bridge_header(void)
+{
+	if (format == FORMAT_JSON)
+		json_open(NULL, '[');
+	else if (format == FORMAT_TSV)
+		out_str("#name\tbridge_id\tstp\ttrill\tinterfaces\n");
 	else
-		printf("\n");
+		out_str("bridge name\tbridge id\t\tSTP\tTRILL\tinterfaces\n");
+}
+
+void br_dump_bridge_footer(void)
+{
+	if (format == FORMAT_JSON)
+		json_close(']');
 }
 
-static int dump_port_info(const char *br, const char *p,  void *arg)
+/* one line of show; returns 1 if the bridge could not be read */
+int br_dump_bridge(const struct br_snapshot *snap,
+		   const struct br_snapshot_bridge *b)
 {
-	struct port_info pinfo;
+	const struct bridge_info *info = &b->info;
+
+	if (format == FORMAT_JSON) {
+		br_dump_bridge_json(snap, b);
+		return 0;
+	}
+	if (format == FORMAT_TSV)
+		return br_dump_bridge_tsv(snap, b);
+
+	out_str(b->name);
+	out_str("\t\t");
 
-	if (br_get_port_info(br, p, &pinfo)) {
-		printf("Can't get info for %p",p);
+	if (b->error) {
+		/* the error goes on the line of the bridge */
+		out_flush();
+		fprintf(stderr, "can't get info %s\n",
+				strerror(b->error));
 		return 1;
 	}
 
-	printf("%s (%d)\n", p, pinfo.port_no);
-	printf(" port id\t\t%.4x",  pinfo.port_id);
-	printf("\t\t\tstate\t\t%15s\n", br_get_state_name(pinfo.state));
-	printf(" designated root\t");
-	br_dump_bridge_id((unsigned char *)&pinfo.designated_root);
-	printf("\tpath cost\t\t%4i\n", pinfo.path_cost);
-
-	printf(" designated bridge\t");
-	br_dump_bridge_id((unsigned char *)&pinfo.designated_bridge);
-	printf("\tmessage age timer\t");
-	br_show_timer(&pinfo.message_age_timer_value);
-	printf("\n designated port\t%.4x", pinfo.designated_port);
-	printf("\t\t\tforward delay timer\t");
-	br_show_timer(&pinfo.forward_delay_timer_value);
-	printf("\n designated cost\t%4i", pinfo.designated_cost);
-	printf("\t\t\thold timer\t\t");
-	br_show_timer(&pinfo.hold_timer_value);
-	printf("\n flags\t\t\t");
-	if (pinfo.config_pending)
-		printf("CONFIG_PENDING ");
-	if (pinfo.top_change_ack)
-		printf("TOPOLOGY_CHANGE_ACK ");
-	if (pinfo.hairpin_mode)
-		printf("\n hairpin mode\t\t\%4i", pinfo.hairpin_mode);
-	printf("\n");
-	printf("\n");
+	out_bridge_id((unsigned char *)&info->bridge_id);
+	out_str(info->stp_enabled ? "\tyes\t" : "\tno\t");
+	out_str(info->trill_enabled ? "yes\t" : "no\t");
+
+
+	br_dump_interface_list(snap, b);
 	return 0;
 }
 
-void br_dump_info(const char *br, const struct bridge_info *bri)
-{
-	int err;
-
-	printf("%s\n", br);
-	printf(" bridge id\t\t");
-	br_dump_bridge_id((unsigned char *)&bri->bridge_id);
-	printf("\n designated root\t");
-	br_dump_bridge_id((unsigned char *)&bri->designated_root);
-	printf("\n root port\t\t%4i\t\t\t", bri->root_port);
-	printf("path cost\t\t%4i\n", bri->root_path_cost);
-	printf(" max age\t\t");
-	br_show_timer(&bri->max_age);
-	printf("\t\t\tbridge max age\t\t");
-	br_show_timer(&bri->bridge_max_age);
-	printf("\n hello time\t\t");
-	br_show_timer(&bri->hello_time);
-	printf("\t\t\tbridge hello time\t");
-	br_show_timer(&bri->bridge_hello_time);
-	printf("\n forward delay\t\t");
-	br_show_timer(&bri->forward_delay);
-	printf("\t\t\tbridge forward delay\t");
-	br_show_timer(&bri->bridge_forward_delay);
-	printf("\n ageing time\t\t");
-	br_show_timer(&bri->ageing_time);
-	printf("\n hello timer\t\t");
-	br_show_timer(&bri->hello_timer_value);
-	printf("\t\t\ttcn timer\t\t");
-	br_show_timer(&bri->tcn_timer_value);
-	printf("\n topology change timer\t");
-	br_show_timer(&bri->topology_change_timer_value);
-	printf("\t\t\tgc timer\t\t");
-	br_show_timer(&bri->gc_timer_value);
-	printf("\n flags\t\t\t");
-	if (bri->topology_change)
-		printf("TOPOLOGY_CHANGE ");
-	if (bri->topology_change_detected)
-		printf("TOPOLOGY_CHANGE_DETECTED ");
-	printf("\n");
-	printf("\n");
-	printf("\n");
-
-	err = br_foreach_port(br, dump_port_info, NULL);
-	if (err < 0)
-		printf("can't get ports: %s\n", strerror(-err));
+/* show of a bridge that is not there */
+void br_dump_bridge_error(const char *name, int err)
+{
+	if (format == FORMAT_JSON) {
+		json_open(NULL, '{');
+		json_str("name", name);
+		json_str("error", strerror(err));
+		json_close('}');
+	} else {
+		out_flush();
+		fprintf(stderr, "can't get info %s\n", strerror(err));
+	}
+}
+
+/* showstp of n bridges; failing ones are reported and skipped */
+int br_dump_stp(const struct br_snapshot *snap,
+		const struct br_snapshot_bridge *b, int n)
+{
+	int i, err = 0;
+
+	if (format == FORMAT_JSON) {
+		json_open(NULL, '[');
+		for (i = 0; i < n; i++) {
+			br_dump_info_json(snap, b + i);
+			err |= b[i].error;
+		}
+		json_close(']');
+		return err != 0;
+	}
+
+	if (format == FORMAT_TSV) {
+		br_dump_info_tsv_header();
+		for (i = 0; i < n; i++)
+			err |= br_dump_info_tsv(snap, b + i);
+		return err != 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (b[i].error) {
+			out_flush();
+			fprintf(stderr, "%s: can't get info %s\n", b[i].name,
+				strerror(b[i].error));
+			err = 1;
+			continue;
+		}
+		br_dump_info(snap, b + i);
+	}
+	return err;
+}
+
+/* showmacs and showmacs_nick lines, in the chosen format */
+void br_dump_fdb_header(int has_nick)
+{
+	if (format == FORMAT_JSON)
+		json_open(NULL, '[');
+	else if (format == FORMAT_TSV)
+		out_str(has_nick
+			? "#port_no\tmac\tnick\tis_local\tageing_timer\n"
+			: "#port_no\tmac\tis_local\tageing_timer\n");
+	else
+		out_str(has_nick
+			? "port no\tmac addr\t\tnick\t\tis local?\tageing timer\n"
+			: "port no\tmac addr\t\tis local?\tageing timer\n");
+}
+
+void br_dump_fdb_footer(void)
+{
+	if (format == FORMAT_JSON)
+		json_close(']');
+}
+
+/* nick is negative if there is none */
+void br_dump_fdb(const unsigned char *mac, int port_no, int nick,
+		 int is_local, const struct timeval *ageing)
+{
+	if (format == FORMAT_JSON) {
+		json_open(NULL, '{');
+		json_int("port_no", port_no);
+		json_mac("mac", mac);
+		if (nick >= 0)
+			json_int("nick", nick);
+		json_bool("is_local", is_local);
+		json_timer("ageing_timer", ageing);
+		json_close('}');
+	} else if (format == FORMAT_TSV) {
+		out_int(port_no, 0);
+		out_char('\t');
+		out_mac(mac);
+		if (nick >= 0) {
+			out_char('\t');
+			out_int(nick, 0);
+		}
+		out_str(is_local ? "\t1\t" : "\t0\t");
+		out_tsv_timer(ageing);
+		out_char('\n');
+	} else {
+		out_int(port_no, 3);
+		out_char('\t');
+		out_mac(mac);
+		if (nick >= 0) {
+			out_char('\t');
+			out_int(nick, 0);
+			out_char('\t');
+		}
+		out_str(is_local ? "\tyes\t\t" : "\tno\t\t");
+		out_timer(ageing);
+		out_char('\n');
+	}
+}
+
+/* showvs of a br_vni_table_get() result, which may be NULL */
+void br_dump_vs(const struct br_vni_table *t)
+{
+	char ifname[IFNAMSIZ];
+	int i, j;
+
+	if (format == FORMAT_JSON)
+		json_open(NULL, '[');
+	else if (format == FORMAT_TSV)
+		out_str("#vni\tinterface\n");
+	for (i = 0; t && i < t->nvnis; i++) {
+		const struct br_vni *v = t->vnis + i;
+
+		if (format == FORMAT_JSON) {
+			json_open(NULL, '{');
+			json_int("vni", v->vni);
+			json_open("interfaces", '[');
+		} else if (format == FORMAT_TEXT)
+			out_printf("--------------- \nvni\t%i\ninterfaces:\n",
+				   v->vni);
+		for (j = 0; j < v->nports; j++) {
+			if (!br_if_indextoname(t->ports[v->first_port + j], ifname))
+				snprintf(ifname, IFNAMSIZ, "if%d",
+					 t->ports[v->first_port + j]);
+			if (format == FORMAT_JSON)
+				json_str(NULL, ifname);
+			else if (format == FORMAT_TSV) {
+				out_int(v->vni, 0);
+				out_char('\t');
+				out_tsv_str(ifname);
+				out_char('\n');
+			} else
+				out_printf("\t%s\n",ifname);
+		}
+		if (format == FORMAT_JSON) {
+			json_close(']');
+			json_close('}');
+		}
+	}
+	if (format == FORMAT_JSON)
+		json_close(']');
+	else if (format == FORMAT_TEXT && t && t->nvnis > 0)
+		out_str("--------------- \n");
 }
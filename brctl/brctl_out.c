@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/time.h>
+
+#include "libbridge.h"
+#include "brctl.h"
+
+/*
+ * All of brctl's standard output goes through this buffer,
+ * which is written out only when full or on out_flush().
+ */
+#define OUT_SIZE	65536
+
+static struct {
+	int fd;
+	int error;
+	size_t len;
+	char buf[OUT_SIZE];
+} out = { .fd = STDOUT_FILENO };
+
+static const char hexdigits[] = "0123456789abcdef";
+
+/* Send output to fd from now on; what is buffered goes to the old one */
+void out_init(int fd)
+{
+	out_flush();
+	out.fd = fd;
+	out.error = 0;
+}
+
+/* Returns 0, or -1 with errno set if output was lost */
+int out_flush(void)
+{
+	size_t done = 0;
+
+	while (done < out.len && !out.error) {
+		ssize_t cc = write(out.fd, out.buf + done, out.len - done);
+
+		if (cc < 0) {
+			if (errno == EINTR)
+				continue;
+			out.error = errno;
+			break;
+		}
+		done += cc;
+	}
+	out.len = 0;
+
+	if (out.error) {
+		errno = out.error;
+		return -1;
+	}
+	return 0;
+}
+
+/* Room for at least len more bytes */
+static inline char *out_reserve(size_t len)
+{
+	if (out.len + len > OUT_SIZE)
+		out_flush();
+	return out.buf + out.len;
+}
+
+void out_mem(const char *s, size_t len)
+{
+	while (len > OUT_SIZE - out.len) {
+		size_t n = OUT_SIZE - out.len;
+
+		memcpy(out.buf + out.len, s, n);
+		out.len += n;
+		out_flush();
+		s += n;
+		len -= n;
+	}
+
+	memcpy(out.buf + out.len, s, len);
+	out.len += len;
+}
+
+void out_str(const char *s)
+{
+	out_mem(s, strlen(s));
+}
+
+void out_char(char c)
+{
+	*out_reserve(1) = c;
+	out.len++;
+}
+
+/* Like printf("%*i", width, v) */
+void out_int(int v, int width)
+{
+	char tmp[12], *p = tmp + sizeof(tmp), *b;
+	unsigned int u = v < 0 ? -(unsigned int) v : v;
+	int n;
+
+	do {
+		*--p = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	if (v < 0)
+		*--p = '-';
+
+	n = tmp + sizeof(tmp) - p;
+	b = out_reserve(width > n ? width : n);
+	if (width > n) {
+		memset(b, ' ', width - n);
+		b += width - n;
+		out.len += width - n;
+	}
+	memcpy(b, p, n);
+	out.len += n;
+}
+
+/* Like printf("%.*x", digits, v) for up to 8 digits */
+void out_hex(unsigned int v, int digits)
+{
+	char *b = out_reserve(digits);
+	int i;
+
+	for (i = digits - 1; i >= 0; i--, v >>= 4)
+		b[i] = hexdigits[v & 0xf];
+	out.len += digits;
+}
+
+static inline char *hex_byte(char *b, unsigned char x)
+{
+	b[0] = hexdigits[x >> 4];
+	b[1] = hexdigits[x & 0xf];
+	return b + 2;
+}
+
+/* 00:11:22:33:44:55 */
+void out_mac(const unsigned char *mac)
+{
+	char *b = out_reserve(17);
+	int i;
+
+	for (i = 0; i < 6; i++) {
+		if (i)
+			*b++ = ':';
+		b = hex_byte(b, mac[i]);
+	}
+	out.len += 17;
+}
+
+/* 8000.001122334455 */
+void out_bridge_id(const unsigned char *id)
+{
+	char *b = out_reserve(17);
+	int i;
+
+	b = hex_byte(b, id[0]);
+	b = hex_byte(b, id[1]);
+	*b++ = '.';
+	for (i = 2; i < 8; i++)
+		b = hex_byte(b, id[i]);
+	out.len += 17;
+}
+
+static void timer_width(const struct timeval *tv, int width)
+{
+	int cs = tv->tv_usec / 10000;
+
+	out_int(tv->tv_sec, width);
+	out_char('.');
+	if (cs >= 0 && cs < 10)
+		out_char('0');
+	out_int(cs, 0);
+}
+
+/* Seconds with hundredths, like printf("%4i.%.2i") */
+void out_timer(const struct timeval *tv)
+{
+	timer_width(tv, 4);
+}
+
+/* A name in a tab separated line: tabs, newlines and \ escaped */
+void out_tsv_str(const char *s)
+{
+	for (; *s; s++) {
+		switch (*s) {
+		case '\t':
+			out_str("\\t");
+			break;
+		case '\n':
+			out_str("\\n");
+			break;
+		case '\\':
+			out_str("\\\\");
+			break;
+		default:
+			out_char(*s);
+		}
+	}
+}
+
+/* Seconds with hundredths, unpadded */
+void out_tsv_timer(const struct timeval *tv)
+{
+	timer_width(tv, 0);
+}
+
+/*
+ * Streaming JSON: values are written as they come, only
+ * whether a comma is due is remembered for each open level.
+ */
+#define JSON_DEPTH	8
+
+static struct {
+	int depth;
+	unsigned char more[JSON_DEPTH];
+} json;
+
+static void json_string(const char *s)
+{
+	out_char('"');
+	for (; *s; s++) {
+		unsigned char c = *s;
+
+		if (c == '"' || c == '\\') {
+			out_char('\\');
+			out_char(c);
+		} else if (c < 0x20) {
+			out_str("\\u00");
+			out_hex(c, 2);
+		} else
+			out_char(c);
+	}
+	out_char('"');
+}
+
+/* comma if needed, then "key": in objects (key is NULL in arrays) */
+static void json_next(const char *key)
+{
+	if (json.depth > 0 && json.depth <= JSON_DEPTH) {
+		if (json.more[json.depth - 1])
+			out_char(',');
+		json.more[json.depth - 1] = 1;
+	}
+	if (key) {
+		json_string(key);
+		out_char(':');
+	}
+}
+
+/* Start an object ('{') or an array ('[') */
+void json_open(const char *key, char bracket)
+{
+	json_next(key);
+	out_char(bracket);
+	if (json.depth < JSON_DEPTH)
+		json.more[json.depth] = 0;
+	++json.depth;
+}
+
+void json_close(char bracket)
+{
+	out_char(bracket);
+	if (--json.depth == 0)
+		out_char('\n');
+}
+
+void json_str(const char *key, const char *value)
+{
+	json_next(key);
+	json_string(value);
+}
+
+void json_int(const char *key, int value)
+{
+	json_next(key);
+	out_int(value, 0);
+}
+
+void json_bool(const char *key, int value)
+{
+	json_next(key);
+	out_str(value ? "true" : "false");
+}
+
+/* hex digits as a string, like port ids */
+void json_hex(const char *key, unsigned int value, int digits)
+{
+	json_next(key);
+	out_char('"');
+	out_hex(value, digits);
+	out_char('"');
+}
+
+void json_mac(const char *key, const unsigned char *mac)
+{
+	json_next(key);
+	out_char('"');
+	out_mac(mac);
+	out_char('"');
+}
+
+void json_bridge_id(const char *key, const unsigned char *id)
+{
+	json_next(key);
+	out_char('"');
+	out_bridge_id(id);
+	out_char('"');
+}
+
+/* seconds, as a number with two decimals */
+void json_timer(const char *key, const struct timeval *tv)
+{
+	json_next(key);
+	timer_width(tv, 0);
+}
+
+void out_printf(const char *fmt, ...)
+{
+	va_list ap;
+	size_t room = OUT_SIZE - out.len;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(out.buf + out.len, room, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return;
+	if (n < room) {
+		out.len += n;
+		return;
+	}
+
+	/* did not fit: make room, or bypass the buffer */
+	out_flush();
+	va_start(ap, fmt);
+	if (n < OUT_SIZE)
+		out.len = vsnprintf(out.buf, OUT_SIZE, fmt, ap);
+	else if (!out.error)
+		vdprintf(out.fd, fmt, ap);
+	va_end(ap);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "libbridge.h"
+#include "brctl.h"
+
+/* a 48 bit mac address as an integer, and where its entry is */
+struct mac_key
+{
+	unsigned long long mac;
+	size_t index;
+};
+
+static inline unsigned long long mac_to_key(const unsigned char *mac)
+{
+	unsigned long long key = 0;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		key = (key << 8) | mac[i];
+
+	return key;
+}
+
+/*
+ * Sort n forwarding entries of size bytes, each starting with
+ * its mac address (struct fdb_entry and fdb_entry_nick), by mac
+ * address. The keys are radix sorted a byte at a time, least
+ * significant first, skipping bytes that are the same in every
+ * entry, then the entries are moved once. Equal addresses keep
+ * their order. Returns -1 if out of memory, leaving fdbs alone.
+ */
+int sort_fdbs(void *fdbs, size_t n, size_t size)
+{
+	struct mac_key *keys, *tmp, *k;
+	unsigned char *out;
+	size_t count[256], i;
+	int shift;
+
+	if (n < 2)
+		return 0;
+
+	keys = malloc(2 * n * sizeof(struct mac_key));
+	if (!keys)
+		return -1;
+	tmp = keys + n;
+
+	for (i = 0; i < n; i++) {
+		keys[i].mac = mac_to_key((unsigned char *) fdbs + i * size);
+		keys[i].index = i;
+	}
+
+	for (shift = 0; shift < 48; shift += 8) {
+		size_t sum = 0;
+
+		memset(count, 0, sizeof(count));
+		for (i = 0; i < n; i++)
+			++count[(keys[i].mac >> shift) & 0xff];
+
+		if (count[(keys[0].mac >> shift) & 0xff] == n)
+			continue;
+
+		for (i = 0; i < 256; i++) {
+			size_t c = count[i];
+
+			count[i] = sum;
+			sum += c;
+		}
+
+		for (i = 0; i < n; i++)
+			tmp[count[(keys[i].mac >> shift) & 0xff]++] = keys[i];
+
+		k = keys;
+		keys = tmp;
+		tmp = k;
+	}
+
+	out = malloc(n * size);
+	if (!out) {
+		free(keys < tmp ? keys : tmp);
+		return -1;
+	}
+
+	for (i = 0; i < n; i++)
+		memcpy(out + i * size,
+		       (unsigned char *) fdbs + keys[i].index * size, size);
+	memcpy(fdbs, out, n * size);
+
+	free(out);
+	free(keys < tmp ? keys : tmp);
+	return 0;
+}
@@ -0,0 +1,730 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * brstatd keeps bridges, ports, virtual networks and forwarding
+ * tables in memory, up to date from netlink notifications, and
+ * answers brctl --daemon over a UNIX socket from that copy.
+ *
+ * A request is one line: the output format, then the command and
+ * its arguments, separated by spaces. The answer is zero or more
+ * "!message" lines for standard error, a "=status" line, and the
+ * output of the command until the daemon closes the connection.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <getopt.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "libbridge.h"
+#include "config.h"
+
+#include "brctl.h"
+
+int format = FORMAT_TEXT;
+
+/*
+ * What is known of a bridge besides its snapshot entry. The
+ * ageing_timer_value of a cached fdb entry is the time it was last
+ * updated, so that its age can be given when it is asked for, or
+ * zero if the entry does not age.
+ */
+struct cached_bridge
+{
+	char name[IFNAMSIZ];
+	struct fdb_entry *fdb;		/* sorted by mac address, vlan */
+	int nfdb;
+	int size;
+	int fdb_error;			/* errno if fdb could not be read */
+	struct timeval fdb_read;	/* when fdb was last read whole */
+	struct br_vni_table *vnis;	/* NULL if it could not be read */
+	int vni_error;			/* errno if vnis could not be read */
+};
+
+static struct {
+	struct br_snapshot *snap;
+	struct cached_bridge *bridges;	/* same order as snap->bridges */
+	int stale;			/* bridges or ports changed */
+} cache;
+
+static volatile sig_atomic_t stopping;
+
+static int compare_fdbs(const void *_f0, const void *_f1)
+{
+	const struct fdb_entry *f0 = _f0;
+	const struct fdb_entry *f1 = _f1;
+	int ret = memcmp(f0->mac_addr, f1->mac_addr, 6);
+
+	return ret ? ret : f0->vlan - f1->vlan;
+}
+
+/*
+ * sort_fdbs() orders by mac address only, keeping the vlans of
+ * an address in the order read: an insertion sort only has
+ * these few to move.
+ */
+static void sort_vlans(struct fdb_entry *fdb, int n)
+{
+	struct fdb_entry f;
+	int i, j;
+
+	for (i = 1; i < n; i++) {
+		if (compare_fdbs(fdb + i - 1, fdb + i) <= 0)
+			continue;
+		f = fdb[i];
+		for (j = i; j > 0 && compare_fdbs(fdb + j - 1, &f) > 0; j--)
+			fdb[j] = fdb[j - 1];
+		fdb[j] = f;
+	}
+}
+
+static struct cached_bridge *cache_find(const char *name, int *index)
+{
+	int i;
+
+	for (i = 0; cache.snap && i < cache.snap->nbridges; i++) {
+		if (!strncmp(cache.bridges[i].name, name, IFNAMSIZ)) {
+			if (index)
+				*index = i;
+			return cache.bridges + i;
+		}
+	}
+	return NULL;
+}
+
+/* one consistent read of the table, kept sorted */
+static void load_fdb(struct cached_bridge *cb)
+{
+	struct fdb_entry *fdb;
+	struct timeval now;
+	int i, n;
+
+	cb->nfdb = 0;
+	cb->fdb_error = 0;
+	n = br_fdb_snapshot(cb->name, &fdb, NULL);
+	if (n < 0) {
+		cb->fdb_error = -n;
+		return;
+	}
+
+	gettimeofday(&now, NULL);
+	cb->fdb_read = now;
+	for (i = 0; i < n; i++) {
+		struct timeval *tv = &fdb[i].ageing_timer_value;
+
+		/* static entries are read with no age at all */
+		if (fdb[i].is_local || !timerisset(tv))
+			timerclear(tv);
+		else
+			timersub(&now, tv, tv);
+	}
+
+	free(cb->fdb);
+	cb->fdb = fdb;
+	cb->nfdb = cb->size = n;
+	if (sort_fdbs(cb->fdb, cb->nfdb, sizeof(struct fdb_entry)))
+		qsort(cb->fdb, cb->nfdb, sizeof(struct fdb_entry), compare_fdbs);
+	else
+		sort_vlans(cb->fdb, cb->nfdb);
+}
+
+static void load_vnis(struct cached_bridge *cb)
+{
+	br_vni_table_free(cb->vnis);
+	cb->vnis = br_vni_table_get(cb->name);
+	cb->vni_error = cb->vnis ? 0 : errno;
+}
+
+static void free_bridges(struct cached_bridge *bridges, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		free(bridges[i].fdb);
+		br_vni_table_free(bridges[i].vnis);
+	}
+	free(bridges);
+}
+
+/*
+ * Read bridges and ports again. Forwarding tables of bridges
+ * already known are kept, unless full is set: they are kept up
+ * to date by the notifications.
+ */
+static int cache_refresh(int full)
+{
+	struct br_snapshot *snap;
+	struct cached_bridge *bridges, *old;
+	int i;
+
+	snap = br_snapshot_take(NULL, BR_INFO_ALL, BR_PORT_ALL,
+				BR_SNAPSHOT_PORTS);
+	if (!snap)
+		return -1;
+
+	bridges = calloc(snap->nbridges + 1, sizeof(struct cached_bridge));
+	if (!bridges) {
+		br_snapshot_free(snap);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (i = 0; i < snap->nbridges; i++) {
+		struct cached_bridge *cb = bridges + i;
+
+		strncpy(cb->name, snap->bridges[i].name, IFNAMSIZ);
+		old = full ? NULL : cache_find(cb->name, NULL);
+		if (old && !old->fdb_error) {
+			cb->fdb = old->fdb;
+			cb->nfdb = old->nfdb;
+			cb->size = old->size;
+			cb->fdb_read = old->fdb_read;
+			old->fdb = NULL;
+		} else
+			load_fdb(cb);
+		load_vnis(cb);
+	}
+
+	if (cache.snap) {
+		free_bridges(cache.bridges, cache.snap->nbridges);
+		br_snapshot_free(cache.snap);
+	}
+	cache.snap = snap;
+	cache.bridges = bridges;
+	cache.stale = 0;
+	return 0;
+}
+
+/* index of the first entry not below f, by mac address and vlan */
+static int fdb_search(const struct cached_bridge *cb,
+		      const struct fdb_entry *f)
+{
+	int lo = 0, hi = cb->nfdb;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (compare_fdbs(cb->fdb + mid, f) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void fdb_event(struct cached_bridge *cb, const struct br_event *ev)
+{
+	int i = fdb_search(cb, &ev->fdb);
+	int found = i < cb->nfdb && !compare_fdbs(cb->fdb + i, &ev->fdb);
+	struct fdb_entry *f;
+
+	if (ev->type == BR_EVENT_FDB_DEL) {
+		if (found) {
+			memmove(cb->fdb + i, cb->fdb + i + 1,
+				(cb->nfdb - i - 1) * sizeof(struct fdb_entry));
+			--cb->nfdb;
+		}
+		return;
+	}
+
+	if (!found) {
+		if (cb->nfdb == cb->size) {
+			int size = cb->size ? 2 * cb->size : 1024;
+
+			f = realloc(cb->fdb, size * sizeof(struct fdb_entry));
+			if (!f) {
+				/* read it all again after this batch */
+				cb->fdb_error = ENOMEM;
+				cache.stale = 1;
+				return;
+			}
+			cb->fdb = f;
+			cb->size = size;
+		}
+		memmove(cb->fdb + i + 1, cb->fdb + i,
+			(cb->nfdb - i) * sizeof(struct fdb_entry));
+		++cb->nfdb;
+	}
+
+	/* just learned or refreshed */
+	f = cb->fdb + i;
+	*f = ev->fdb;
+	if (ev->is_static)
+		timerclear(&f->ageing_timer_value);
+	else
+		f->ageing_timer_value = ev->time;
+}
+
+static int cache_event(const struct br_event *ev, void *arg)
+{
+	struct cached_bridge *cb;
+
+	switch (ev->type) {
+	case BR_EVENT_FDB_ADD:
+	case BR_EVENT_FDB_DEL:
+		cb = cache_find(ev->bridge, NULL);
+		if (cb && !cb->fdb_error)
+			fdb_event(cb, ev);
+		break;
+	default:
+		cache.stale = 1;
+	}
+	return 0;
+}
+
+/* read all pending notifications, then what they made stale */
+static void cache_update(struct br_monitor *m)
+{
+	int n;
+
+	while ((n = br_monitor_dispatch(m, cache_event, NULL)) >= 0
+	       || n == -EINTR)
+		;
+
+	if (n == -ENOBUFS) {
+		fprintf(stderr, "brstatd: events lost, reading all again\n");
+		if (cache_refresh(1))
+			fprintf(stderr, "brstatd: can't read bridges: %s\n",
+				strerror(errno));
+		return;
+	}
+	if (n != -EAGAIN)
+		fprintf(stderr, "brstatd: monitor failed: %s\n", strerror(-n));
+
+	if (cache.stale && cache_refresh(0))
+		fprintf(stderr, "brstatd: can't read bridges: %s\n",
+			strerror(errno));
+}
+
+static void reply_error(const char *fmt, ...)
+	__attribute__ ((format (printf, 1, 2)));
+
+/* a line for the standard error of the client, before the status */
+static void reply_error(const char *fmt, ...)
+{
+	char msg[256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+
+	out_char('!');
+	out_str(msg);
+	out_char('\n');
+}
+
+static void reply_status(int status)
+{
+	out_char('=');
+	out_int(status, 0);
+	out_char('\n');
+}
+
+static int query_show(int argc, char **argv)
+{
+	const struct br_snapshot *snap = cache.snap;
+	const char *err = strerror(ENODEV);
+	int i, index;
+
+	/* what brctl says of bridges that are not there */
+	for (i = 1; i < argc; i++) {
+		if (cache_find(argv[i], NULL))
+			continue;
+		if (format == FORMAT_TEXT)
+			reply_error("can't get info %s", err);
+		else if (format == FORMAT_TSV)
+			reply_error("%s: can't get info %s", argv[i], err);
+	}
+	reply_status(0);
+
+	br_dump_bridge_header();
+	if (argc == 1) {
+		for (i = 0; i < snap->nbridges; i++)
+			if (br_dump_bridge(snap, snap->bridges + i))
+				break;
+	} else {
+		for (i = 1; i < argc; i++) {
+			if (cache_find(argv[i], &index))
+				br_dump_bridge(snap, snap->bridges + index);
+			else if (format == FORMAT_JSON)
+				br_dump_bridge_error(argv[i], ENODEV);
+			else if (format == FORMAT_TEXT) {
+				out_str(argv[i]);
+				out_str("\t\t");
+			}
+		}
+	}
+	br_dump_bridge_footer();
+	return 0;
+}
+
+static int query_showstp(int argc, char **argv)
+{
+	const struct br_snapshot *snap = cache.snap;
+	const struct br_snapshot_bridge *b = snap->bridges;
+	int i, index, n = snap->nbridges, err = 0;
+
+	if (strcmp(argv[1], "all")) {
+		if (!cache_find(argv[1], &index)) {
+			struct br_snapshot_bridge missing;
+			struct br_snapshot none = { &missing, 1, NULL, 0 };
+
+			memset(&missing, 0, sizeof(missing));
+			strncpy(missing.name, argv[1], IFNAMSIZ - 1);
+			missing.error = ENODEV;
+
+			if (format != FORMAT_JSON)
+				reply_error("%s: can't get info %s", argv[1],
+					    strerror(ENODEV));
+			reply_status(1);
+			if (format == FORMAT_JSON)
+				br_dump_stp(&none, &missing, 1);
+			else if (format == FORMAT_TSV)
+				br_dump_info_tsv_header();
+			return 1;
+		}
+		b += index;
+		n = 1;
+	}
+
+	for (i = 0; i < n; i++)
+		err |= b[i].error;
+	reply_status(err != 0);
+
+	return br_dump_stp(snap, b, n);
+}
+
+/*
+ * Traffic refreshes an entry without a notification, so the ages
+ * counted from the last read or event only grow. They are trusted
+ * for half the ageing time after the table was read, and as long
+ * as none of them reaches the ageing time, past which the kernel
+ * would have removed the entry.
+ */
+static int fdb_ages_stale(const struct cached_bridge *cb,
+			  const struct timeval *ageing,
+			  const struct timeval *now)
+{
+	struct timeval half, elapsed, age;
+	int i;
+
+	half.tv_sec = ageing->tv_sec / 2;
+	half.tv_usec = (ageing->tv_usec + (ageing->tv_sec % 2) * 1000000) / 2;
+	timersub(now, &cb->fdb_read, &elapsed);
+	if (!timercmp(&elapsed, &half, <))
+		return 1;
+
+	for (i = 0; i < cb->nfdb; i++) {
+		const struct fdb_entry *f = cb->fdb + i;
+
+		if (!timerisset(&f->ageing_timer_value))
+			continue;
+		timersub(now, &f->ageing_timer_value, &age);
+		if (!timercmp(&age, ageing, <))
+			return 1;
+	}
+	return 0;
+}
+
+static int query_showmacs(int argc, char **argv)
+{
+	struct cached_bridge *cb;
+	struct timeval now;
+	int i, index;
+
+	if (argc != 2) {
+		reply_error("brstatd only answers showmacs <bridge>");
+		reply_status(1);
+		return 1;
+	}
+
+	cb = cache_find(argv[1], &index);
+	gettimeofday(&now, NULL);
+	if (cb && !cb->fdb_error
+	    && fdb_ages_stale(cb, &cache.snap->bridges[index].info.ageing_time,
+			      &now)) {
+		load_fdb(cb);
+		gettimeofday(&now, NULL);
+	}
+	if (!cb || cb->fdb_error) {
+		reply_error("read of forward table failed: %s",
+			    strerror(cb ? cb->fdb_error : ENODEV));
+		reply_status(1);
+		return 1;
+	}
+	reply_status(0);
+
+	br_dump_fdb_header(0);
+	for (i = 0; i < cb->nfdb; i++) {
+		const struct fdb_entry *f = cb->fdb + i;
+		struct timeval age;
+
+		timerclear(&age);
+		if (timerisset(&f->ageing_timer_value))
+			timersub(&now, &f->ageing_timer_value, &age);
+		if (age.tv_sec < 0)
+			timerclear(&age);
+		br_dump_fdb(f->mac_addr, f->port_no, -1, f->is_local, &age);
+	}
+	br_dump_fdb_footer();
+	return 0;
+}
+
+static int query_showvs(int argc, char **argv)
+{
+	struct cached_bridge *cb = cache_find(argv[1], NULL);
+
+	if (!cb || !cb->vnis) {
+		reply_error("can't get virtual networks of %s: %s", argv[1],
+			    strerror(cb ? cb->vni_error : ENODEV));
+		reply_status(1);
+		return 1;
+	}
+	reply_status(0);
+	br_dump_vs(cb->vnis);
+	return 0;
+}
+
+static int query_refresh(int argc, char **argv)
+{
+	if (cache_refresh(1)) {
+		reply_error("can't read bridges: %s", strerror(errno));
+		reply_status(1);
+		return 1;
+	}
+	reply_status(0);
+	return 0;
+}
+
+static const struct query
+{
+	const char *name;
+	int nargs;
+	int (*func)(int argc, char **argv);
+} queries[] = {
+	{ "show", 0, query_show },
+	{ "showstp", 1, query_showstp },
+	{ "showmacs", 1, query_showmacs },
+	{ "showvs", 1, query_showvs },
+	{ "refresh", 0, query_refresh },
+};
+
+#define NR_QUERIES	(sizeof(queries)/sizeof(queries[0]))
+#define MAX_REQUEST	4096
+#define MAX_ARGS	64
+
+/* read one request line, answer it and hang up */
+static void serve(int lfd)
+{
+	static const struct timeval timeout = { .tv_sec = 5 };
+	char req[MAX_REQUEST], *argv[MAX_ARGS], *tok;
+	int fd, i, complete, argc = 0;
+	size_t len = 0;
+	ssize_t cc;
+
+	fd = accept(lfd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	/* a client that stalls must not hold up the others for long */
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	while (len < sizeof(req) - 1 && !memchr(req, '\n', len)) {
+		cc = read(fd, req + len, sizeof(req) - 1 - len);
+		if (cc < 0 && errno == EINTR)
+			continue;
+		if (cc <= 0)
+			break;
+		len += cc;
+	}
+	req[len] = '\0';
+	complete = memchr(req, '\n', len) != NULL;
+
+	for (tok = strtok(req, " \t\r\n"); tok && argc < MAX_ARGS;
+	     tok = strtok(NULL, " \t\r\n"))
+		argv[argc++] = tok;
+
+	out_init(fd);
+	if (!complete || argc < 2) {
+		reply_error("brstatd: bad request");
+		reply_status(1);
+		goto done;
+	}
+
+	if (!strcmp(argv[0], "json"))
+		format = FORMAT_JSON;
+	else if (!strcmp(argv[0], "tsv"))
+		format = FORMAT_TSV;
+	else
+		format = FORMAT_TEXT;
+
+	for (i = 0; i < NR_QUERIES; i++)
+		if (!strcmp(argv[1], queries[i].name))
+			break;
+	if (i == NR_QUERIES) {
+		reply_error("brstatd does not answer %s", argv[1]);
+		reply_status(1);
+	} else if (argc < queries[i].nargs + 2) {
+		reply_error("Incorrect number of arguments for command");
+		reply_status(1);
+	} else
+		queries[i].func(argc - 1, argv + 1);
+
+done:
+	out_init(STDOUT_FILENO);
+	close(fd);
+}
+
+static int listen_on(const char *path)
+{
+	struct sockaddr_un sun;
+	int fd;
+
+	if (strlen(path) >= sizeof(sun.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strcpy(sun.sun_path, path);
+	unlink(path);
+
+	if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0
+	    || listen(fd, 16) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void stop(int sig)
+{
+	stopping = 1;
+}
+
+static void help(void)
+{
+	printf("Usage: brstatd [-s socket]\n");
+}
+
+int main(int argc, char *const* argv)
+{
+	const char *path = BRSTATD_SOCKET;
+	struct br_monitor *m;
+	struct sigaction sa;
+	struct pollfd pfd[2];
+	int f, lfd;
+	static const struct option options[] = {
+		{ .name = "help", .val = 'h' },
+		{ .name = "version", .val = 'V' },
+		{ .name = "socket", .has_arg = required_argument, .val = 's' },
+		{ 0 }
+	};
+
+	while ((f = getopt_long(argc, argv, "Vhs:", options, NULL)) != EOF)
+		switch (f) {
+		case 's':
+			path = optarg;
+			break;
+		case 'h':
+			help();
+			return 0;
+		case 'V':
+			printf("brstatd, %s\n", PACKAGE_VERSION);
+			return 0;
+		default:
+			help();
+			return 1;
+		}
+
+	if (br_init()) {
+		fprintf(stderr, "can't setup bridge control: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	/* events that come while reading are applied afterwards */
+	m = br_monitor_open(NULL);
+	if (!m) {
+		fprintf(stderr, "can't monitor bridges: %s\n",
+			strerror(errno));
+		return 1;
+	}
+	fcntl(br_monitor_fd(m), F_SETFL, O_NONBLOCK);
+
+	if (cache_refresh(1)) {
+		fprintf(stderr, "can't read bridges: %s\n", strerror(errno));
+		return 1;
+	}
+
+	lfd = listen_on(path);
+	if (lfd < 0) {
+		fprintf(stderr, "can't listen on %s: %s\n", path,
+			strerror(errno));
+		return 1;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop;
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+
+	pfd[0].fd = br_monitor_fd(m);
+	pfd[0].events = POLLIN;
+	pfd[1].fd = lfd;
+	pfd[1].events = POLLIN;
+
+	while (!stopping) {
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "poll: %s\n", strerror(errno));
+			break;
+		}
+
+		/* events first, so answers are as fresh as can be */
+		if (pfd[0].revents)
+			cache_update(m);
+		if (pfd[1].revents & POLLIN)
+			serve(lfd);
+	}
+
+	unlink(path);
+	close(lfd);
+	br_monitor_close(m);
+	br_shutdown();
+	return 0;
+}
@@ -29,11 +29,18 @@
 #define BRCTL_GET_VS_PORT_LIST 21
 #define BRCTL_GET_FDB_ENTRIES_NICK 22
 
+/* ends the ifindexes of a vni in BRCTL_GET_VS_PORT_LIST results */
+#define VS_SEPARATOR 0xF0F0F0F0
+
 
 /* defined in net/if.h but that conflicts with linux/if.h... */
 extern unsigned int if_nametoindex (const char *__ifname);
 extern char *if_indextoname (unsigned int __ifindex, char *__ifname);
 
+/* the same, answered from a table kept by libbridge */
+extern unsigned int br_if_nametoindex(const char *ifname);
+extern char *br_if_indextoname(unsigned int ifindex, char *ifname);
+
 
 struct bridge_id
 {
@@ -69,6 +76,7 @@ struct fdb_entry
 	u_int8_t mac_addr[6];
 	u_int16_t port_no;
 	unsigned char is_local;
+	u_int16_t vlan;		/* 0 if none, or not known */
 	struct timeval ageing_timer_value;
 };
 
@@ -112,6 +120,164 @@ struct port_info
 	unsigned char hairpin_mode;
 };
 
+struct br_snapshot_bridge
+{
+	char name[IFNAMSIZ];
+	struct bridge_info info;
+	int error;		/* errno if info could not be read */
+	int port_error;		/* errno if ports could not be listed */
+	int first_port;		/* index of first port in ports[] */
+	int nports;
+	int fdb_count;		/* -1 if not collected or failed */
+	int fdb_error;		/* errno if the table could not be read */
+};
+
+struct br_snapshot_port
+{
+	char name[IFNAMSIZ];
+	struct port_info info;
+	int error;		/* errno if info could not be read */
+	int bridge;		/* index of bridge in bridges[] */
+};
+
+struct br_snapshot
+{
+	struct br_snapshot_bridge *bridges;
+	int nbridges;
+	struct br_snapshot_port *ports;
+	int nports;
+};
+
+/*
+ * A dump of a table that changed while it was read is started again
+ * this many times at most, after a delay that doubles each time.
+ */
+#define BR_DUMP_TRIES	8
+
+/* Forwarding entries behind one TRILL nickname */
+#define BR_NICK_ANY	(-1)
+
+struct br_nick_count
+{
+	u_int16_t nick;
+	unsigned int total;
+	unsigned int local;
+};
+
+/* a port and its vni, for br_set_trill_vnis() */
+struct br_port_vni
+{
+	const char *port;
+	int vni;		/* label, from br_vni_label() */
+	int error;		/* set by br_set_trill_vnis() */
+};
+
+/* a virtual network of a bridge, from br_vni_table_get() */
+struct br_vni
+{
+	u_int32_t vni;
+	int first_port;		/* index of its first port in ports[] */
+	int nports;
+};
+
+struct br_vni_port
+{
+	int ifindex;
+	u_int32_t vni;
+};
+
+struct br_vni_table
+{
+	struct br_vni *vnis;		/* sorted by vni */
+	int nvnis;
+	int *ports;			/* ifindexes, grouped by vni */
+	int nports;
+	struct br_vni_port *by_port;	/* nports, sorted by ifindex */
+};
+
+/*
+ * Forwarding entries by ageing timer, for br_fdb_stats(): bucket i
+ * holds timers below BR_FDB_AGE_LIMITS[i] seconds and not below the
+ * limit before it; the last bucket has no upper limit.
+ */
+#define BR_FDB_AGE_BUCKETS	8
+#define BR_FDB_AGE_LIMITS	{ 1, 5, 15, 30, 60, 120, 300 }
+
+struct br_fdb_port_stats
+{
+	u_int16_t port_no;
+	unsigned int total;
+	unsigned int local;
+	unsigned int age[BR_FDB_AGE_BUCKETS];	/* learned entries only */
+};
+
+struct br_fdb_stats
+{
+	struct br_fdb_port_stats all;	/* port_no is 0 */
+	struct br_fdb_port_stats *ports; /* by port_no, with entries only */
+	int nports;
+};
+
+/* changes reported by br_monitor_dispatch() */
+enum br_event_type
+{
+	BR_EVENT_PORT_ADD,
+	BR_EVENT_PORT_DEL,
+	BR_EVENT_PORT_STATE,
+	BR_EVENT_FDB_ADD,
+	BR_EVENT_FDB_DEL,
+	BR_EVENT_BRIDGE_ADD,
+	BR_EVENT_BRIDGE_DEL,
+	BR_EVENT_BRIDGE_CHANGE,		/* link attributes notified */
+};
+
+struct br_event
+{
+	enum br_event_type type;
+	struct timeval time;		/* when it was received */
+	char bridge[IFNAMSIZ];
+	char port[IFNAMSIZ];		/* empty for BR_EVENT_BRIDGE_* */
+	unsigned char state;		/* BR_STATE_* of the port */
+	unsigned char old_state;	/* before BR_EVENT_PORT_STATE */
+	struct fdb_entry fdb;		/* mac_addr, is_local, vlan for FDB */
+	unsigned char is_static;	/* FDB entry does not age */
+};
+
+struct br_monitor;
+
+/* flags for br_snapshot_take() */
+#define BR_SNAPSHOT_PORTS	0x0001
+#define BR_SNAPSHOT_FDB_COUNT	0x0002
+
+/* fields of struct bridge_info, for br_get_bridge_info_mask() */
+#define BR_INFO_DESIGNATED_ROOT	0x0001
+#define BR_INFO_BRIDGE_ID	0x0002
+#define BR_INFO_ROOT_PATH_COST	0x0004
+#define BR_INFO_MAX_AGE		0x0008	/* and bridge_max_age */
+#define BR_INFO_HELLO_TIME	0x0010	/* and bridge_hello_time */
+#define BR_INFO_FORWARD_DELAY	0x0020	/* and bridge_forward_delay */
+#define BR_INFO_AGEING_TIME	0x0040
+#define BR_INFO_TIMERS		0x0080	/* hello, tcn, topology change, gc */
+#define BR_INFO_ROOT_PORT	0x0100
+#define BR_INFO_STP_ENABLED	0x0200
+#define BR_INFO_TRILL_ENABLED	0x0400
+#define BR_INFO_TOPOLOGY_CHANGE	0x0800	/* and topology_change_detected */
+#define BR_INFO_ALL		0x0fff
+
+/* fields of struct port_info, for br_get_port_info_mask() */
+#define BR_PORT_DESIGNATED_ROOT	0x0001
+#define BR_PORT_DESIGNATED_BRIDGE 0x0002
+#define BR_PORT_NO		0x0004
+#define BR_PORT_ID		0x0008
+#define BR_PORT_DESIGNATED_PORT	0x0010
+#define BR_PORT_PATH_COST	0x0020
+#define BR_PORT_DESIGNATED_COST	0x0040
+#define BR_PORT_STATE		0x0080
+#define BR_PORT_FLAGS		0x0100	/* top_change_ack, config_pending */
+#define BR_PORT_TIMERS		0x0200	/* message age, forward delay, hold */
+#define BR_PORT_HAIRPIN_MODE	0x0400
+#define BR_PORT_ALL		0x07ff
+
 extern int br_init(void);
 extern int br_refresh(void);
 extern void br_shutdown(void);
@@ -125,8 +291,12 @@ extern int br_foreach_port(const char *brname,
 extern const char *br_get_state_name(int state);
 
 extern int br_get_bridge_info(const char *br, struct bridge_info *info);
+extern int br_get_bridge_info_mask(const char *br, unsigned int mask,
+				   struct bridge_info *info);
 extern int br_get_port_info(const char *brname, const char *port, 
 			    struct port_info *info);
+extern int br_get_port_info_mask(const char *brname, const char *port,
+				 unsigned int mask, struct port_info *info);
 extern int br_add_bridge(const char *brname);
 extern int br_del_bridge(const char *brname);
 extern int br_add_interface(const char *br, const char *dev);
@@ -143,12 +313,55 @@ extern int br_set_path_cost(const char *br, const char *p,
 			    int path_cost);
 extern int br_read_fdb(const char *br, struct fdb_entry *fdbs, 
 		       unsigned long skip, int num);
+extern int br_foreach_fdb(const char *br,
+			  int (*iterator)(const struct fdb_entry *fdb,
+					  void *arg),
+			  void *arg);
+extern int br_fdb_snapshot(const char *br, struct fdb_entry **fdbs,
+			   int *retries);
+extern int br_fdb_lookup(const char *br, const unsigned char *mac,
+			 struct fdb_entry *ent);
+extern int br_fdb_stats(const char *br, struct br_fdb_stats *stats);
+extern void br_fdb_stats_free(struct br_fdb_stats *stats);
 extern int br_set_hairpin_mode(const char *bridge, const char *dev,
 			       int hairpin_mode);
 extern int br_read_fdb_nick(const char *br, struct fdb_entry_nick *fdbs,
 			    unsigned long skip, int num);
+extern int br_foreach_fdb_nick(const char *br, int nick,
+			       int (*iterator)(const struct fdb_entry_nick *fdb,
+					       void *arg),
+			       void *arg);
+extern int br_fdb_nick_snapshot(const char *br, struct fdb_entry_nick **fdbs,
+				int *retries);
+extern int br_fdb_nicks(const char *br, struct br_nick_count **counts,
+			int *retries);
+extern void br_backoff(int retry);
 extern int br_set_trill_state(const char *br, int trill_state);
+extern u_int32_t br_vni_label(u_int32_t vni);
+extern u_int32_t br_label_vni(u_int32_t label);
 extern int br_set_trill_vni(const char *br, const char *p , int vlanlabel);
+extern int br_set_trill_vnis(const char *br, struct br_port_vni *pv, int n);
+extern struct br_snapshot *br_snapshot_take(const char *brname,
+					    unsigned int bmask,
+					    unsigned int pmask,
+					    unsigned int flags);
+extern struct br_snapshot *br_snapshot_take_threads(const char *brname,
+						    unsigned int bmask,
+						    unsigned int pmask,
+						    unsigned int flags,
+						    int nthreads);
+extern void br_snapshot_free(struct br_snapshot *snap);
+extern struct br_monitor *br_monitor_open(const char *bridge);
+extern int br_monitor_fd(const struct br_monitor *m);
+extern int br_monitor_dispatch(struct br_monitor *m,
+			       int (*handler)(const struct br_event *, void *),
+			       void *arg);
+extern void br_monitor_close(struct br_monitor *m);
 extern int vs_get_port_list(const char *brname,u_int32_t *ifindex);
+extern struct br_vni_table *br_vni_table_get(const char *bridge);
+extern const struct br_vni *br_vni_lookup(const struct br_vni_table *t,
+					  u_int32_t vni);
+extern int br_vni_of_port(const struct br_vni_table *t, int ifindex);
+extern void br_vni_table_free(struct br_vni_table *t);
 
 #endif
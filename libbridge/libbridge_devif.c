@@ -22,54 +22,234 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
-#include <dirent.h>
 #include <sys/fcntl.h>
 
 #include "libbridge.h"
 #include "libbridge_private.h"
 
-static FILE *fpopen(const char *dir, const char *name)
+/*
+ * sysfs attributes are read relative to an open directory, with
+ * openat and pread into a small buffer, and parsed by hand.
+ * Returns length read, or -1.
+ */
+static int fetch_attr(int dirfd, const char *name, char *buf, size_t size)
 {
-	char path[SYSFS_PATH_MAX];
+	int fd, cc;
+
+	fd = openat(dirfd, name, O_RDONLY);
+	if (fd < 0)
+		return -1;
 
-	snprintf(path, SYSFS_PATH_MAX, "%s/%s", dir, name);
-	return fopen(path, "r");
+	cc = pread(fd, buf, size - 1, 0);
+	close(fd);
+	if (cc < 0)
+		return -1;
+
+	buf[cc] = '\0';
+	return cc;
 }
 
-static void fetch_id(const char *dev, const char *name, struct bridge_id *id)
+static inline int hexval(int c)
 {
-	FILE *f = fpopen(dev, name);
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
 
-	if (!f)
-		fprintf(stderr, "%s: %s\n", dev, strerror(errno));
-	else {
-		fscanf(f, "%2hhx%2hhx.%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
-		       &id->prio[0], &id->prio[1],
-		       &id->addr[0], &id->addr[1], &id->addr[2],
-		       &id->addr[3], &id->addr[4], &id->addr[5]);
-		fclose(f);
+/* Parse an integer the way "%i" does: decimal, 0x hex or 0 octal. */
+static int parse_int(const char *cp, int *value)
+{
+	unsigned long v = 0;
+	int neg = 0, base = 10, d, ndigits = 0;
+
+	while (*cp == ' ' || *cp == '\t')
+		++cp;
+	if (*cp == '-' || *cp == '+')
+		neg = (*cp++ == '-');
+
+	if (cp[0] == '0' && (cp[1] == 'x' || cp[1] == 'X')
+	    && hexval(cp[2]) >= 0) {
+		base = 16;
+		cp += 2;
+	} else if (cp[0] == '0')
+		base = 8;
+
+	while ((d = hexval(*cp)) >= 0 && d < base) {
+		v = v * base + d;
+		++cp;
+		++ndigits;
+	}
+
+	if (ndigits == 0)
+		return -1;
+
+	*value = neg ? -(int) v : (int) v;
+	return 0;
+}
+
+static void fetch_id(int dirfd, const char *name, struct bridge_id *id)
+{
+	char buf[32];
+	unsigned char *x = (unsigned char *) id;
+	const char *cp = buf;
+	int i;
+
+	if (fetch_attr(dirfd, name, buf, sizeof(buf)) < 0) {
+		fprintf(stderr, "%s: %s\n", name, strerror(errno));
+		return;
+	}
+
+	/* pppp.aaaaaaaaaaaa */
+	for (i = 0; i < 8; i++) {
+		int hi, lo;
+
+		if (i == 2 && *cp == '.')
+			++cp;
+		if ((hi = hexval(cp[0])) < 0 || (lo = hexval(cp[1])) < 0)
+			break;
+		x[i] = hi << 4 | lo;
+		cp += 2;
 	}
 }
 
 /* Fetch an integer attribute out of sysfs. */
-static int fetch_int(const char *dev, const char *name)
+static int fetch_int(int dirfd, const char *name)
 {
-	FILE *f = fpopen(dev, name);
+	char buf[32];
 	int value = -1;
 
-	if (!f) 
+	if (fetch_attr(dirfd, name, buf, sizeof(buf)) < 0)
 		return 0;
 
-	fscanf(f, "%i", &value);
-	fclose(f);
+	parse_int(buf, &value);
 	return value;
 }
 
 /* Get a time value out of sysfs */
-static void fetch_tv(const char *dev, const char *name, 
-		    struct timeval *tv)
+static void fetch_tv(int dirfd, const char *name, struct timeval *tv)
+{
+	__jiffies_to_tv(tv, fetch_int(dirfd, name));
+}
+
+/*
+ * Open a file below /sys/class/net, relative to the directory
+ * handle opened by br_init when there is one.
+ */
+static int open_sysfs(const char *rel, int flags)
+{
+	char path[SYSFS_PATH_MAX];
+
+	if (br_sysfs_fd >= 0)
+		return openat(br_sysfs_fd, rel, flags);
+
+	snprintf(path, SYSFS_PATH_MAX, SYSFS_CLASS_NET "%s", rel);
+	return open(path, flags);
+}
+
+/* Open a sysfs directory of a device, e.g. "bridge" or "brport" */
+static int open_sysfs_dir(const char *dev, const char *sub)
+{
+	char path[SYSFS_PATH_MAX];
+
+	snprintf(path, SYSFS_PATH_MAX, "%s/%s", dev, sub);
+	return open_sysfs(path, O_RDONLY | O_DIRECTORY);
+}
+
+/* Port number of a bridge port, 0 if unknown */
+int sysfs_port_no(const char *port)
+{
+	int dirfd, port_no;
+
+	dirfd = open_sysfs_dir(port, "brport");
+	if (dirfd < 0)
+		return 0;
+
+	port_no = fetch_int(dirfd, "port_no");
+	close(dirfd);
+	return port_no;
+}
+
+/*
+ * ifindex to port number map of the last bridge looked up,
+ * sorted by ifindex. Built from one BRCTL_GET_PORT_LIST and kept
+ * while br_links_generation() says no device changed, so ports
+ * were neither added nor removed. When changes can't be followed
+ * it is kept until a lookup misses or the kernel refuses a port
+ * number, and then read again.
+ */
+struct port_map {
+	int ifindex;
+	int portno;
+};
+
+static __thread struct {
+	char bridge[IFNAMSIZ];
+	struct port_map *map;
+	int count;
+	int size;
+	unsigned int gen;
+} port_cache;
+
+void br_port_cache_flush(void)
+{
+	port_cache.bridge[0] = '\0';
+	port_cache.count = 0;
+}
+
+static int port_map_cmp(const void *_m0, const void *_m1)
+{
+	const struct port_map *m0 = _m0;
+	const struct port_map *m1 = _m1;
+
+	return m0->ifindex - m1->ifindex;
+}
+
+static int port_cache_fill(const char *brname)
 {
-	__jiffies_to_tv(tv, fetch_int(dev, name));
+	int i, num, *ifindices;
+
+	br_port_cache_flush();
+
+	/* taken before the list, so a change while reading it is seen */
+	port_cache.gen = br_links_generation();
+	num = br_get_port_list(brname, &ifindices);
+	if (num < 0) {
+		dprintf("get_portno: get ports of %s failed: %s\n", 
+			brname, strerror(-num));
+		errno = -num;
+		return -1;
+	}
+
+	if (num > port_cache.size) {
+		struct port_map *map;
+
+		map = realloc(port_cache.map, num * sizeof(struct port_map));
+		if (!map) {
+			free(ifindices);
+			errno = ENOMEM;
+			return -1;
+		}
+		port_cache.map = map;
+		port_cache.size = num;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (!ifindices[i])
+			continue;
+		port_cache.map[port_cache.count].ifindex = ifindices[i];
+		port_cache.map[port_cache.count].portno = i;
+		++port_cache.count;
+	}
+	free(ifindices);
+	qsort(port_cache.map, port_cache.count, sizeof(struct port_map),
+	      port_map_cmp);
+	strncpy(port_cache.bridge, brname, IFNAMSIZ);
+
+	return 0;
 }
 
 /*
@@ -78,38 +258,88 @@ static void fetch_tv(const char *dev, const char *name,
  * Old API does bridge operations as if ports were an array
  * inside bridge structure.
  */
+static int port_cache_valid(const char *brname)
+{
+	unsigned int gen;
+
+	if (strncmp(port_cache.bridge, brname, IFNAMSIZ))
+		return 0;
+	gen = br_links_generation();
+	return gen == 0 || gen == port_cache.gen;
+}
+
+static struct port_map *port_cache_find(int ifindex)
+{
+	struct port_map key;
+
+	key.ifindex = ifindex;
+	return bsearch(&key, port_cache.map, port_cache.count,
+		       sizeof(struct port_map), port_map_cmp);
+}
+
 static int get_portno(const char *brname, const char *ifname)
 {
-	int i;
-	int ifindex = if_nametoindex(ifname);
-	int ifindices[MAX_PORTS];
-	unsigned long args[4] = { BRCTL_GET_PORT_LIST,
-				  (unsigned long)ifindices, MAX_PORTS, 0 };
-	struct ifreq ifr;
+	struct port_map *m;
+	int ifindex, filled;
 
+	ifindex = br_if_nametoindex(ifname);
 	if (ifindex <= 0)
-		goto error;
-
-	memset(ifindices, 0, sizeof(ifindices));
-	strncpy(ifr.ifr_name, brname, IFNAMSIZ);
-	ifr.ifr_data = (char *) &args;
+		return -1;
 
-	if (ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr) < 0) {
-		dprintf("get_portno: get ports of %s failed: %s\n", 
-			brname, strerror(errno));
-		goto error;
-	}
+	filled = !port_cache_valid(brname);
+	if (filled && port_cache_fill(brname) < 0)
+		return -1;
 
-	for (i = 0; i < MAX_PORTS; i++) {
-		if (ifindices[i] == ifindex)
-			return i;
+	m = port_cache_find(ifindex);
+	if (!m && !filled) {
+		/* may have been added since the list was read */
+		if (port_cache_fill(brname) < 0)
+			return -1;
+		m = port_cache_find(ifindex);
 	}
+	if (m)
+		return m->portno;
 
 	dprintf("%s is not a in bridge %s\n", ifname, brname);
- error:
+	errno = EINVAL;
 	return -1;
 }
 
+static int portno_ioctl(const char *bridge, int index,
+			unsigned long cmd, unsigned long value)
+{
+	struct ifreq ifr;
+	unsigned long args[4] = { cmd, index, value, 0 };
+
+	strncpy(ifr.ifr_name, bridge, IFNAMSIZ);
+	ifr.ifr_data = (char *) &args;
+	return ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
+}
+
+/*
+ * Issue a per port ioctl; if the kernel does not know the
+ * port number any more, drop the cached port list and retry once.
+ */
+static int port_ioctl(const char *bridge, const char *ifname,
+		      unsigned long cmd, unsigned long value)
+{
+	int retries = 0, index, ret;
+
+ again:
+	index = get_portno(bridge, ifname);
+	if (index < 0)
+		return -1;
+	ret = portno_ioctl(bridge, index, cmd, value);
+
+	if (ret < 0 && (errno == ENODEV || errno == EINVAL)) {
+		br_port_cache_flush();
+		if (retries++ == 0)
+			goto again;
+	}
+
+	return ret;
+}
+
 /* get information via ioctl */
 static int old_get_bridge_info(const char *bridge, struct bridge_info *info)
 {
@@ -153,50 +383,75 @@ static int old_get_bridge_info(const char *bridge, struct bridge_info *info)
 
 /*
  * Get bridge parameters using either sysfs or old
- * ioctl.
+ * ioctl. Only the fields in mask (BR_INFO_xxx) are read
+ * from sysfs, the others are left zero.
  */
-int br_get_bridge_info(const char *bridge, struct bridge_info *info)
+int br_get_bridge_info_mask(const char *bridge, unsigned int mask,
+			    struct bridge_info *info)
 {
-	DIR *dir;
-	char path[SYSFS_PATH_MAX];
+	int dirfd;
 
-	snprintf(path, SYSFS_PATH_MAX, SYSFS_CLASS_NET "%s/bridge", bridge);
-	dir = opendir(path);
-	if (dir == NULL) {
-		dprintf("path '%s' is not a directory\n", path);
+	dirfd = open_sysfs_dir(bridge, "bridge");
+	if (dirfd < 0) {
+		dprintf("%s has no bridge directory\n", bridge);
 		goto fallback;
 	}
 
 	memset(info, 0, sizeof(*info));
-	fetch_id(path, "root_id", &info->designated_root);
-	fetch_id(path, "bridge_id", &info->bridge_id);
-	info->root_path_cost = fetch_int(path, "root_path_cost");
-	fetch_tv(path, "max_age", &info->max_age);
-	fetch_tv(path, "hello_time", &info->hello_time);
-	fetch_tv(path, "forward_delay", &info->forward_delay);
-	fetch_tv(path, "max_age", &info->bridge_max_age);
-	fetch_tv(path, "hello_time", &info->bridge_hello_time);
-	fetch_tv(path, "forward_delay", &info->bridge_forward_delay);
-	fetch_tv(path, "ageing_time", &info->ageing_time);
-	fetch_tv(path, "hello_timer", &info->hello_timer_value);
-	fetch_tv(path, "tcn_timer", &info->tcn_timer_value);
-	fetch_tv(path, "topology_change_timer", 
-		 &info->topology_change_timer_value);;
-	fetch_tv(path, "gc_timer", &info->gc_timer_value);
-
-	info->root_port = fetch_int(path, "root_port");
-	info->stp_enabled = fetch_int(path, "stp_state");
-	info->trill_enabled = fetch_int(path, "trill_state");
-	info->topology_change = fetch_int(path, "topology_change");
-	info->topology_change_detected = fetch_int(path, "topology_change_detected");
-
-	closedir(dir);
+	if (mask & BR_INFO_DESIGNATED_ROOT)
+		fetch_id(dirfd, "root_id", &info->designated_root);
+	if (mask & BR_INFO_BRIDGE_ID)
+		fetch_id(dirfd, "bridge_id", &info->bridge_id);
+	if (mask & BR_INFO_ROOT_PATH_COST)
+		info->root_path_cost = fetch_int(dirfd, "root_path_cost");
+
+	/* sysfs has only one copy of these */
+	if (mask & BR_INFO_MAX_AGE) {
+		fetch_tv(dirfd, "max_age", &info->max_age);
+		info->bridge_max_age = info->max_age;
+	}
+	if (mask & BR_INFO_HELLO_TIME) {
+		fetch_tv(dirfd, "hello_time", &info->hello_time);
+		info->bridge_hello_time = info->hello_time;
+	}
+	if (mask & BR_INFO_FORWARD_DELAY) {
+		fetch_tv(dirfd, "forward_delay", &info->forward_delay);
+		info->bridge_forward_delay = info->forward_delay;
+	}
+
+	if (mask & BR_INFO_AGEING_TIME)
+		fetch_tv(dirfd, "ageing_time", &info->ageing_time);
+	if (mask & BR_INFO_TIMERS) {
+		fetch_tv(dirfd, "hello_timer", &info->hello_timer_value);
+		fetch_tv(dirfd, "tcn_timer", &info->tcn_timer_value);
+		fetch_tv(dirfd, "topology_change_timer", 
+			 &info->topology_change_timer_value);
+		fetch_tv(dirfd, "gc_timer", &info->gc_timer_value);
+	}
+
+	if (mask & BR_INFO_ROOT_PORT)
+		info->root_port = fetch_int(dirfd, "root_port");
+	if (mask & BR_INFO_STP_ENABLED)
+		info->stp_enabled = fetch_int(dirfd, "stp_state");
+	if (mask & BR_INFO_TRILL_ENABLED)
+		info->trill_enabled = fetch_int(dirfd, "trill_state");
+	if (mask & BR_INFO_TOPOLOGY_CHANGE) {
+		info->topology_change = fetch_int(dirfd, "topology_change");
+		info->topology_change_detected = fetch_int(dirfd, "topology_change_detected");
+	}
+
+	close(dirfd);
 	return 0;
 
 fallback:
 	return old_get_bridge_info(bridge, info);
 }
 
+int br_get_bridge_info(const char *bridge, struct bridge_info *info)
+{
+	return br_get_bridge_info_mask(bridge, BR_INFO_ALL, info);
+}
+
 static int old_get_port_info(const char *brname, const char *port,
 			     struct port_info *info)
 {
@@ -244,49 +499,67 @@ static int old_get_port_info(const char *brname, const char *port,
 }
 
 /*
- * Get information about port on bridge.
+ * Get information about port on bridge. Only the fields in
+ * mask (BR_PORT_xxx) are read from sysfs, the others are left zero.
  */
-int br_get_port_info(const char *brname, const char *port, 
-		     struct port_info *info)
+int br_get_port_info_mask(const char *brname, const char *port,
+			  unsigned int mask, struct port_info *info)
 {
-	DIR *d;
-	char path[SYSFS_PATH_MAX];
+	int dirfd;
 
-	snprintf(path, SYSFS_PATH_MAX, SYSFS_CLASS_NET "%s/brport", port);
-	d = opendir(path);
-	if (!d)
+	dirfd = open_sysfs_dir(port, "brport");
+	if (dirfd < 0)
 		goto fallback;
 
 	memset(info, 0, sizeof(*info));
 
-	fetch_id(path, "designated_root", &info->designated_root);
-	fetch_id(path, "designated_bridge", &info->designated_bridge);
-	info->port_no = fetch_int(path, "port_no");
-	info->port_id = fetch_int(path, "port_id");
-	info->designated_port = fetch_int(path, "designated_port");
-	info->path_cost = fetch_int(path, "path_cost");
-	info->designated_cost = fetch_int(path, "designated_cost");
-	info->state = fetch_int(path, "state");
-	info->top_change_ack = fetch_int(path, "change_ack");
-	info->config_pending = fetch_int(path, "config_pending");
-	fetch_tv(path, "message_age_timer", &info->message_age_timer_value);
-	fetch_tv(path, "forward_delay_timer", &info->forward_delay_timer_value);
-	fetch_tv(path, "hold_timer", &info->hold_timer_value);
-	info->hairpin_mode = fetch_int(path, "hairpin_mode");
-
-	closedir(d);
+	if (mask & BR_PORT_DESIGNATED_ROOT)
+		fetch_id(dirfd, "designated_root", &info->designated_root);
+	if (mask & BR_PORT_DESIGNATED_BRIDGE)
+		fetch_id(dirfd, "designated_bridge", &info->designated_bridge);
+	if (mask & BR_PORT_NO)
+		info->port_no = fetch_int(dirfd, "port_no");
+	if (mask & BR_PORT_ID)
+		info->port_id = fetch_int(dirfd, "port_id");
+	if (mask & BR_PORT_DESIGNATED_PORT)
+		info->designated_port = fetch_int(dirfd, "designated_port");
+	if (mask & BR_PORT_PATH_COST)
+		info->path_cost = fetch_int(dirfd, "path_cost");
+	if (mask & BR_PORT_DESIGNATED_COST)
+		info->designated_cost = fetch_int(dirfd, "designated_cost");
+	if (mask & BR_PORT_STATE)
+		info->state = fetch_int(dirfd, "state");
+	if (mask & BR_PORT_FLAGS) {
+		info->top_change_ack = fetch_int(dirfd, "change_ack");
+		info->config_pending = fetch_int(dirfd, "config_pending");
+	}
+	if (mask & BR_PORT_TIMERS) {
+		fetch_tv(dirfd, "message_age_timer", &info->message_age_timer_value);
+		fetch_tv(dirfd, "forward_delay_timer", &info->forward_delay_timer_value);
+		fetch_tv(dirfd, "hold_timer", &info->hold_timer_value);
+	}
+	if (mask & BR_PORT_HAIRPIN_MODE)
+		info->hairpin_mode = fetch_int(dirfd, "hairpin_mode");
+
+	close(dirfd);
 
 	return 0;
 fallback:
 	return old_get_port_info(brname, port, info);
 }
 
+int br_get_port_info(const char *brname, const char *port, 
+		     struct port_info *info)
+{
+	return br_get_port_info_mask(brname, port, BR_PORT_ALL, info);
+}
+
 static int set_sysfs(const char *path, unsigned long value)
 {
 	int fd, ret = 0, cc;
 	char buf[32];
 
-	fd = open(path, O_WRONLY);
+	fd = open_sysfs(path, O_WRONLY);
 	if (fd < 0)
 		return -1;
 
@@ -305,8 +578,7 @@ static int br_set(const char *bridge, const char *name,
 	int ret;
 	char path[SYSFS_PATH_MAX];
 
-	snprintf(path, SYSFS_PATH_MAX, SYSFS_CLASS_NET "%s/bridge/%s",
-		 bridge, name);
+	snprintf(path, SYSFS_PATH_MAX, "%s/bridge/%s", bridge, name);
 
 	if ((ret = set_sysfs(path, value)) < 0) {
 		/* fallback to old ioctl */
@@ -363,22 +635,10 @@ static int port_set(const char *bridge, const char *ifname,
 	int ret;
 	char path[SYSFS_PATH_MAX];
 
-	snprintf(path, SYSFS_PATH_MAX, SYSFS_CLASS_NET "%s/brport/%s", ifname, name);
+	snprintf(path, SYSFS_PATH_MAX, "%s/brport/%s", ifname, name);
 
-	if ((ret = set_sysfs(path, value)) < 0) {
-		int index = get_portno(bridge, ifname);
-
-		if (index < 0)
-			ret = index;
-		else {
-			struct ifreq ifr;
-			unsigned long args[4] = { oldcode, index, value, 0 };
-			
-			strncpy(ifr.ifr_name, bridge, IFNAMSIZ);
-			ifr.ifr_data = (char *) &args;
-			ret = ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
-		}
-	}
+	if ((ret = set_sysfs(path, value)) < 0)
+		ret = port_ioctl(bridge, ifname, oldcode, value);
 
 	return ret < 0 ? errno : 0;
 }
@@ -404,6 +664,7 @@ static inline void __copy_fdb(struct fdb_entry *ent,
 	memcpy(ent->mac_addr, f->mac_addr, 6);
 	ent->port_no = f->port_no;
 	ent->is_local = f->is_local;
+	ent->vlan = 0;
 	__jiffies_to_tv(&ent->ageing_timer_value, f->ageing_timer_value);
 }
 
@@ -418,70 +679,837 @@ static inline void __copy_fdb_nick(struct fdb_entry_nick *ent,
 }
 
 
-int br_read_fdb(const char *bridge, struct fdb_entry *fdbs, 
-		unsigned long offset, int num)
+/*
+ * Read the whole brforward file with one open. Raw entries are
+ * read into a heap buffer which is then grown and converted in
+ * place, last entry first, so no second copy is needed.
+ * Returns number of entries in *fdbs (to be freed by caller)
+ * or -errno.
+ */
+static int sysfs_read_fdb_all(const char *bridge, struct fdb_entry **fdbs)
 {
-	FILE *f;
-	int i, n;
-	struct __fdb_entry fe[num];
 	char path[SYSFS_PATH_MAX];
-	
-	/* open /sys/class/net/brXXX/brforward */
-	snprintf(path, SYSFS_PATH_MAX, SYSFS_CLASS_NET "%s/brforward", bridge);
-	f = fopen(path, "r");
-	if (f) {
-		fseek(f, offset*sizeof(struct __fdb_entry), SEEK_SET);
-		n = fread(fe, sizeof(struct __fdb_entry), num, f);
-		fclose(f);
-	} else {
-		/* old kernel, use ioctl */
-		unsigned long args[4] = { BRCTL_GET_FDB_ENTRIES,
-					  (unsigned long) fe,
-					  num, offset };
-		struct ifreq ifr;
-		int retries = 0;
+	struct __fdb_entry *fe = NULL, raw;
+	struct fdb_entry *ents;
+	size_t size = 0, len = 0;
+	int fd, i, n;
 
-		strncpy(ifr.ifr_name, bridge, IFNAMSIZ);
-		ifr.ifr_data = (char *) args;
+	snprintf(path, SYSFS_PATH_MAX, "%s/brforward", bridge);
+	fd = open_sysfs(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
 
-	retry:
-		n = ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
+	for (;;) {
+		ssize_t cc;
 
-		/* table can change during ioctl processing */
-		if (n < 0 && errno == EAGAIN && ++retries < 10) {
-			sleep(0);
-			goto retry;
+		if (len == size) {
+			void *nfe;
+
+			size = size ? 2 * size : 65536;
+			nfe = realloc(fe, size);
+			if (!nfe) {
+				n = -ENOMEM;
+				goto out;
+			}
+			fe = nfe;
+		}
+
+		cc = pread(fd, (char *) fe + len, size - len, len);
+		if (cc < 0) {
+			if (errno == EINTR)
+				continue;
+			n = -errno;
+			goto out;
 		}
+		if (cc == 0)
+			break;
+		len += cc;
 	}
 
-	for (i = 0; i < n; i++) 
-		__copy_fdb(fdbs+i, fe+i);
+	n = len / sizeof(struct __fdb_entry);
+	ents = realloc(fe, (n + 1) * sizeof(struct fdb_entry));
+	if (!ents) {
+		n = -ENOMEM;
+		goto out;
+	}
+	fe = NULL;
 
+	/* entry i never overlaps raw entries below i */
+	for (i = n - 1; i >= 0; i--) {
+		raw = ((struct __fdb_entry *) ents)[i];
+		__copy_fdb(ents + i, &raw);
+	}
+	*fdbs = ents;
+ out:
+	free(fe);
+	close(fd);
 	return n;
 }
 
-int br_read_fdb_nick(const char *bridge, struct fdb_entry_nick *fdbs,
-		     unsigned long offset, int num)
+/* brforward reads are limited to one page by sysfs */
+#define FDB_CHUNK	256
+
+/* One chunk of the table with the old ioctl. Returns entries read or -1 */
+static int fdb_ioctl(const char *bridge, struct __fdb_entry *fe,
+		     int num, unsigned long offset)
+{
+	unsigned long args[4] = { BRCTL_GET_FDB_ENTRIES,
+				  (unsigned long) fe, num, offset };
+	struct ifreq ifr;
+
+	strncpy(ifr.ifr_name, bridge, IFNAMSIZ);
+	ifr.ifr_data = (char *) args;
+	return ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
+}
+
+/* Growing array of forwarding entries */
+struct fdb_table {
+	struct fdb_entry *ents;
+	int count;
+	int size;
+	int nomem;
+};
+
+static int fdb_table_grow(struct fdb_table *t, int more)
+{
+	int size = t->size ? t->size : 1024;
+	struct fdb_entry *ents;
+
+	while (size < t->count + more)
+		size *= 2;
+	if (size == t->size)
+		return 0;
+
+	ents = realloc(t->ents, size * sizeof(struct fdb_entry));
+	if (!ents) {
+		t->nomem = 1;
+		return -1;
+	}
+	t->ents = ents;
+	t->size = size;
+	return 0;
+}
+
+static int fdb_table_add(const struct fdb_entry *f, void *arg)
+{
+	struct fdb_table *t = arg;
+
+	if (fdb_table_grow(t, 1))
+		return 1;
+	t->ents[t->count++] = *f;
+	return 0;
+}
+
+/* Whole table in one rtnetlink dump */
+static int rtnl_read_fdb_all(int brindex, struct fdb_entry **fdbs)
 {
-	FILE *f;
+	struct fdb_table t = { NULL, 0, 0, 0 };
+	int n;
+
+	n = rtnl_foreach_fdb(brindex, fdb_table_add, &t);
+	if (n >= 0 && t.nomem)
+		n = -ENOMEM;
+	if (n < 0) {
+		free(t.ents);
+		return n;
+	}
+	*fdbs = t.ents;
+	return t.count;
+}
+
+/*
+ * brforward is read a page at a time, each read being a new walk
+ * of the table: the whole file is read until two reads in a row
+ * find as many entries. *prev is the count of the previous read,
+ * or -1. Returns -EAGAIN if the counts differ.
+ */
+static int sysfs_read_fdb_stable(const char *bridge, struct fdb_entry **fdbs,
+				 int *prev)
+{
+	int n, first;
+
+	for (;;) {
+		n = sysfs_read_fdb_all(bridge, fdbs);
+		if (n < 0 || n == *prev)
+			return n;
+
+		first = *prev < 0;
+		*prev = n;
+		free(*fdbs);
+		if (!first)
+			return -EAGAIN;
+	}
+}
+
+/* Whole table with the old ioctl, from the start if EAGAIN */
+static int ioctl_read_fdb_all(const char *bridge, struct fdb_entry **fdbs)
+{
+	struct __fdb_entry fe[FDB_CHUNK];
+	struct fdb_table t = { NULL, 0, 0, 0 };
 	int i, n;
-	struct __fdb_entry_nick fe[num];
+
+	while ((n = fdb_ioctl(bridge, fe, FDB_CHUNK, t.count)) > 0) {
+		if (fdb_table_grow(&t, n)) {
+			free(t.ents);
+			return -ENOMEM;
+		}
+		for (i = 0; i < n; i++)
+			__copy_fdb(t.ents + t.count + i, fe + i);
+		t.count += n;
+	}
+	if (n < 0) {
+		n = -errno;
+		free(t.ents);
+		return n;
+	}
+	*fdbs = t.ents;
+	return t.count;
+}
+
+enum { FDB_RTNL, FDB_SYSFS, FDB_IOCTL };
+
+/*
+ * Read the whole forwarding table of a bridge as it was at one
+ * moment. A read the table changed under (a notification for the
+ * bridge came during the rtnetlink dump, brforward counts differ
+ * between two reads, the ioctl fails with EAGAIN) is started
+ * again after br_backoff(), up to
+ * BR_DUMP_TRIES times. If retries is not NULL the number of
+ * restarts is stored there.
+ * Returns number of entries in *fdbs (to be freed by caller)
+ * or -errno, -EAGAIN if the table never held still.
+ */
+int br_fdb_snapshot(const char *bridge, struct fdb_entry **fdbs,
+		    int *retries)
+{
+	int how = br_netlink_fd >= 0 ? FDB_RTNL : FDB_SYSFS;
+	int brindex = 0, prev = -1, tries = 0, n;
+
+	if (how == FDB_RTNL) {
+		brindex = br_if_nametoindex(bridge);
+		if (brindex == 0)
+			return -ENODEV;
+	}
+
+	for (;;) {
+		if (how == FDB_RTNL)
+			n = rtnl_read_fdb_all(brindex, fdbs);
+		else if (how == FDB_SYSFS)
+			n = sysfs_read_fdb_stable(bridge, fdbs, &prev);
+		else
+			n = ioctl_read_fdb_all(bridge, fdbs);
+
+		if (n == -EAGAIN) {
+			if (++tries == BR_DUMP_TRIES)
+				break;
+			br_backoff(tries - 1);
+			continue;
+		}
+
+		/* not supported this way, try the older one */
+		if (n < 0 && n != -ENOMEM && how != FDB_IOCTL) {
+			++how;
+			continue;
+		}
+		break;
+	}
+
+	if (retries)
+		*retries = tries;
+	return n;
+}
+
+/*
+ * Whole forwarding table, taken with br_fdb_snapshot() when
+ * reading starts at offset 0. Chunks are served from it only while
+ * each call starts where the previous one ended; any other offset
+ * takes a new one. Each thread reads its own copy.
+ */
+static __thread struct {
+	char bridge[IFNAMSIZ];
+	struct fdb_entry *ents;
+	int count;
+	unsigned long next;	/* offset the next chunk starts at */
+} fdb_snap;
+
+void br_fdb_snap_flush(void)
+{
+	free(fdb_snap.ents);
+	fdb_snap.ents = NULL;
+	fdb_snap.bridge[0] = '\0';
+	fdb_snap.count = 0;
+	fdb_snap.next = 0;
+}
+
+static int fdb_snap_take(const char *bridge)
+{
+	struct fdb_entry *ents;
+	int n;
+
+	br_fdb_snap_flush();
+
+	n = br_fdb_snapshot(bridge, &ents, NULL);
+	if (n < 0)
+		return n;
+
+	fdb_snap.ents = ents;
+	fdb_snap.count = n;
+	strncpy(fdb_snap.bridge, bridge, IFNAMSIZ);
+	return 0;
+}
+
+int br_read_fdb(const char *bridge, struct fdb_entry *fdbs, 
+		unsigned long offset, int num)
+{
+	int n;
+
+	if (offset == 0 || offset != fdb_snap.next
+	    || strncmp(fdb_snap.bridge, bridge, IFNAMSIZ)) {
+		int err = fdb_snap_take(bridge);
+
+		if (err) {
+			errno = -err;
+			return -1;
+		}
+	}
+
+	if (offset >= fdb_snap.count) {
+		/* the end: nothing to keep */
+		br_fdb_snap_flush();
+		return 0;
+	}
+
+	n = fdb_snap.count - offset;
+	if (n > num)
+		n = num;
+	memcpy(fdbs, fdb_snap.ents + offset, n * sizeof(struct fdb_entry));
+	fdb_snap.next = offset + n;
+
+	return n;
+}
+
+static int sysfs_foreach_fdb(const char *bridge,
+			     int (*iterator)(const struct fdb_entry *, void *),
+			     void *arg)
+{
+	struct __fdb_entry fe[FDB_CHUNK];
+	struct fdb_entry ent;
 	char path[SYSFS_PATH_MAX];
+	int fd, i, n, count = 0;
+
+	snprintf(path, SYSFS_PATH_MAX, "%s/brforward", bridge);
+	fd = open_sysfs(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	for (;;) {
+		n = read(fd, fe, sizeof(fe));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			count = -errno;
+			break;
+		}
+
+		n /= sizeof(struct __fdb_entry);
+		if (n == 0)
+			break;
+
+		for (i = 0; i < n; i++) {
+			__copy_fdb(&ent, fe + i);
+			++count;
+			if (iterator(&ent, arg))
+				goto out;
+		}
+	}
+ out:
+	close(fd);
+	return count;
+}
+
+static int old_foreach_fdb(const char *bridge,
+			   int (*iterator)(const struct fdb_entry *, void *),
+			   void *arg)
+{
+	struct __fdb_entry fe[FDB_CHUNK];
+	struct fdb_entry ent;
+	int i, n, retries, count = 0;
+
+	for (;;) {
+		retries = 0;
+		/* table can change during ioctl processing */
+		while ((n = fdb_ioctl(bridge, fe, FDB_CHUNK, count)) < 0
+		       && errno == EAGAIN && ++retries < BR_DUMP_TRIES)
+			br_backoff(retries - 1);
+		if (n < 0)
+			return -errno;
+		if (n == 0)
+			break;
+
+		for (i = 0; i < n; i++) {
+			__copy_fdb(&ent, fe + i);
+			++count;
+			if (iterator(&ent, arg))
+				return count;
+		}
+	}
+
+	return count;
+}
+
+/* iterator of br_foreach_fdb, and whether it was called yet */
+struct fdb_walk {
+	int (*iterator)(const struct fdb_entry *, void *);
+	void *arg;
+	int called;
+};
+
+static int fdb_walk_call(const struct fdb_entry *f, void *arg)
+{
+	struct fdb_walk *w = arg;
+
+	w->called = 1;
+	return w->iterator(f, w->arg);
+}
+
+/*
+ * Go over the forwarding database of a bridge and call iterator
+ * for each entry, using a fixed size buffer whatever the size
+ * of the table. If iterator returns non-zero then stop.
+ * A way of reading the table that fails is replaced by an older
+ * one only if it did not hand out any entry yet.
+ * Returns number of entries seen or -errno; -EAGAIN means the
+ * table changed during the walk, which iterator may have seen
+ * entries of twice or missed: br_fdb_snapshot() reads it whole.
+ */
+int br_foreach_fdb(const char *bridge,
+		   int (*iterator)(const struct fdb_entry *, void *),
+		   void *arg)
+{
+	struct fdb_walk w = { iterator, arg, 0 };
+	int ret = -1;
+
+	if (br_netlink_fd >= 0) {
+		int brindex = br_if_nametoindex(bridge);
+
+		if (brindex == 0)
+			return -ENODEV;
+		ret = rtnl_foreach_fdb(brindex, fdb_walk_call, &w);
+		if (ret == -EAGAIN)
+			return ret;
+	}
+	if (ret < 0 && !w.called)
+		ret = sysfs_foreach_fdb(bridge, fdb_walk_call, &w);
+	if (ret < 0 && !w.called)
+		ret = old_foreach_fdb(bridge, fdb_walk_call, &w);
+
+	return ret;
+}
+
+struct fdb_find {
+	const unsigned char *mac;
+	struct fdb_entry *ent;
+	int found;
+};
+
+static int find_fdb(const struct fdb_entry *f, void *arg)
+{
+	struct fdb_find *ff = arg;
+
+	if (memcmp(f->mac_addr, ff->mac, 6))
+		return 0;
+
+	*ff->ent = *f;
+	ff->found = 1;
+	return 1;
+}
+
+/* 1 if bridge filters on VLANs, 0 if not, -1 if unknown */
+static int vlan_filtering(const char *bridge)
+{
+	char buf[32];
+	int dirfd, ret = -1;
+
+	dirfd = open_sysfs_dir(bridge, "bridge");
+	if (dirfd < 0)
+		return -1;
+	if (fetch_attr(dirfd, "vlan_filtering", buf, sizeof(buf)) >= 0)
+		ret = atoi(buf) != 0;
+	close(dirfd);
+	return ret;
+}
+
+/*
+ * Find the forwarding entry of a mac address in a bridge.
+ * Asks the kernel for just that entry if it can, otherwise, or
+ * if the bridge filters on VLANs and the entry may be on one,
+ * scans the table until the address is found.
+ * Returns 0, ENOENT if the address is not known, or errno.
+ */
+int br_fdb_lookup(const char *bridge, const unsigned char *mac,
+		  struct fdb_entry *ent)
+{
+	struct fdb_find ff = { mac, ent, 0 };
+	int ret = -1, tries = 0;
+
+	if (br_netlink_fd >= 0) {
+		int brindex = br_if_nametoindex(bridge);
+
+		if (brindex == 0)
+			return ENODEV;
+		ret = rtnl_fdb_get(brindex, mac, ent);
+		if (ret == 0)
+			return 0;
+		/* only VLAN 0 is asked for: others need the scan */
+		if (ret == -ENOENT && vlan_filtering(bridge) == 0)
+			return ENOENT;
+	}
+
+	/* a walk that did not find it may have missed it */
+	while ((ret = br_foreach_fdb(bridge, find_fdb, &ff)) == -EAGAIN
+	       && ++tries < BR_DUMP_TRIES)
+		br_backoff(tries - 1);
+	if (ret < 0)
+		return -ret;
+
+	return ff.found ? 0 : ENOENT;
+}
+
+/* counters indexed by port_no, while going over the table */
+struct fdb_count {
+	struct br_fdb_port_stats *ports;
+	int size;
+	int nomem;
+};
+
+static const long age_limits[BR_FDB_AGE_BUCKETS - 1] =
+	BR_FDB_AGE_LIMITS;
+
+static void count_entry(struct br_fdb_port_stats *ps,
+			const struct fdb_entry *f)
+{
+	int i;
+
+	++ps->total;
+	if (f->is_local) {
+		++ps->local;
+		return;
+	}
+	/* static entries have no ageing timer: they were not learned */
+	if (!timerisset(&f->ageing_timer_value))
+		return;
+
+	for (i = 0; i < BR_FDB_AGE_BUCKETS - 1; i++)
+		if (f->ageing_timer_value.tv_sec < age_limits[i])
+			break;
+	++ps->age[i];
+}
+
+static int count_fdb(const struct fdb_entry *f, void *arg)
+{
+	struct fdb_count *fc = arg;
+
+	if (f->port_no >= fc->size) {
+		int size = fc->size ? fc->size : 64;
+		struct br_fdb_port_stats *ports;
+
+		while (size <= f->port_no)
+			size *= 2;
+		ports = realloc(fc->ports, size * sizeof(*ports));
+		if (!ports) {
+			fc->nomem = 1;
+			return 1;
+		}
+		memset(ports + fc->size, 0,
+		       (size - fc->size) * sizeof(*ports));
+		fc->ports = ports;
+		fc->size = size;
+	}
+
+	count_entry(fc->ports + f->port_no, f);
+	return 0;
+}
+
+/*
+ * Count the forwarding entries of a bridge per port: all of them,
+ * local ones, and learned ones by ageing timer. One pass over the
+ * table, or more if it changes during one; entries are not kept.
+ * Free with br_fdb_stats_free().
+ * Returns 0 or errno.
+ */
+int br_fdb_stats(const char *bridge, struct br_fdb_stats *stats)
+{
+	struct fdb_count fc = { NULL, 0, 0 };
+	int i, j, n, tries = 0;
+
+	memset(stats, 0, sizeof(*stats));
+
+	/* counting starts over if the table changed meanwhile */
+	while ((n = br_foreach_fdb(bridge, count_fdb, &fc)) == -EAGAIN
+	       && ++tries < BR_DUMP_TRIES) {
+		memset(fc.ports, 0, fc.size * sizeof(*fc.ports));
+		br_backoff(tries - 1);
+	}
+	if (n < 0 || fc.nomem) {
+		free(fc.ports);
+		return n < 0 ? -n : ENOMEM;
+	}
+
+	/* keep the ports that have entries, in place */
+	for (i = 0; i < fc.size; i++) {
+		struct br_fdb_port_stats *ps = fc.ports + i;
+
+		if (ps->total == 0)
+			continue;
+
+		ps->port_no = i;
+		stats->all.total += ps->total;
+		stats->all.local += ps->local;
+		for (j = 0; j < BR_FDB_AGE_BUCKETS; j++)
+			stats->all.age[j] += ps->age[j];
+		fc.ports[stats->nports++] = *ps;
+	}
+
+	stats->ports = fc.ports;
+	return 0;
+}
+
+void br_fdb_stats_free(struct br_fdb_stats *stats)
+{
+	free(stats->ports);
+	stats->ports = NULL;
+	stats->nports = 0;
+}
+
+/* One chunk of the table with nicknames. Returns entries read or -1 */
+static int fdb_nick_ioctl(const char *bridge, struct __fdb_entry_nick *fe,
+			  int num, unsigned long offset)
+{
 	unsigned long args[4] = { BRCTL_GET_FDB_ENTRIES_NICK,
 		(unsigned long) fe, num, offset };
 	struct ifreq ifr;
-	int retries = 0;
+
 	strncpy(ifr.ifr_name, bridge, IFNAMSIZ);
 	ifr.ifr_data = (char *) args;
-retry:
-	n = ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
-	/* table can change during ioctl processing */
-	if (n < 0 && errno == EAGAIN && ++retries < 10) {
-		sleep(0);
-		goto retry;
-	}
-	for (i = 0; i < n; i++)
-		__copy_fdb_nick(fdbs+i, fe+i);
+	return ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
+}
+
+/* Whole table with nicknames, from the start if EAGAIN */
+static int ioctl_read_fdb_nick_all(const char *bridge,
+				   struct fdb_entry_nick **fdbs)
+{
+	struct __fdb_entry_nick fe[FDB_CHUNK];
+	struct fdb_entry_nick *ents = NULL, *more;
+	int i, n, count = 0, size = 0;
+
+	while ((n = fdb_nick_ioctl(bridge, fe, FDB_CHUNK, count)) > 0) {
+		if (count + n > size) {
+			size = size ? 2 * size : 1024;
+			more = realloc(ents, size * sizeof(*ents));
+			if (!more) {
+				free(ents);
+				return -ENOMEM;
+			}
+			ents = more;
+		}
+		for (i = 0; i < n; i++)
+			__copy_fdb_nick(ents + count + i, fe + i);
+		count += n;
+	}
+	if (n < 0) {
+		n = -errno;
+		free(ents);
+		return n;
+	}
+	*fdbs = ents;
+	return count;
+}
+
+/*
+ * Read the whole forwarding table of a bridge with nicknames, as
+ * br_fdb_snapshot() does: a read the table changed under is started
+ * again from the first entry after br_backoff(), up to BR_DUMP_TRIES
+ * times, and the number of restarts is stored in *retries if not NULL.
+ * Returns number of entries in *fdbs (to be freed by caller)
+ * or -errno, -EAGAIN if the table never held still.
+ */
+int br_fdb_nick_snapshot(const char *bridge, struct fdb_entry_nick **fdbs,
+			 int *retries)
+{
+	int tries = 0, n;
+
+	while ((n = ioctl_read_fdb_nick_all(bridge, fdbs)) == -EAGAIN
+	       && ++tries < BR_DUMP_TRIES)
+		br_backoff(tries - 1);
+
+	if (retries)
+		*retries = tries;
+	return n;
+}
+
+/* As fdb_snap, for br_read_fdb_nick() */
+static __thread struct {
+	char bridge[IFNAMSIZ];
+	struct fdb_entry_nick *ents;
+	int count;
+	unsigned long next;
+} fdb_nick_snap;
+
+void br_fdb_nick_snap_flush(void)
+{
+	free(fdb_nick_snap.ents);
+	fdb_nick_snap.ents = NULL;
+	fdb_nick_snap.bridge[0] = '\0';
+	fdb_nick_snap.count = 0;
+	fdb_nick_snap.next = 0;
+}
+
+int br_read_fdb_nick(const char *bridge, struct fdb_entry_nick *fdbs,
+		     unsigned long offset, int num)
+{
+	int n;
+
+	if (offset == 0 || offset != fdb_nick_snap.next
+	    || strncmp(fdb_nick_snap.bridge, bridge, IFNAMSIZ)) {
+		struct fdb_entry_nick *ents;
+
+		br_fdb_nick_snap_flush();
+		n = br_fdb_nick_snapshot(bridge, &ents, NULL);
+		if (n < 0) {
+			errno = -n;
+			return -1;
+		}
+		fdb_nick_snap.ents = ents;
+		fdb_nick_snap.count = n;
+		strncpy(fdb_nick_snap.bridge, bridge, IFNAMSIZ);
+	}
+
+	if (offset >= fdb_nick_snap.count) {
+		br_fdb_nick_snap_flush();
+		return 0;
+	}
+
+	n = fdb_nick_snap.count - offset;
+	if (n > num)
+		n = num;
+	memcpy(fdbs, fdb_nick_snap.ents + offset,
+	       n * sizeof(struct fdb_entry_nick));
+	fdb_nick_snap.next = offset + n;
+
+	return n;
+}
+
+/*
+ * Go over the forwarding entries of a bridge that are behind
+ * nickname nick, or behind any nickname if nick is BR_NICK_ANY,
+ * in chunks of a fixed size buffer. Entries without a nickname
+ * (0) and the others are skipped before being converted. If
+ * iterator returns non-zero then stop.
+ * Returns number of entries read or -errno; -EAGAIN means the
+ * table changed during the walk, which iterator may have seen
+ * entries of twice or missed: start again from the first entry,
+ * as br_fdb_nicks() does.
+ */
+int br_foreach_fdb_nick(const char *bridge, int nick,
+			int (*iterator)(const struct fdb_entry_nick *, void *),
+			void *arg)
+{
+	struct __fdb_entry_nick fe[FDB_CHUNK];
+	struct fdb_entry_nick ent;
+	unsigned long offset = 0;
+	int i, n;
+
+	for (;;) {
+		n = fdb_nick_ioctl(bridge, fe, FDB_CHUNK, offset);
+		if (n < 0)
+			return -errno;
+		if (n == 0)
+			break;
+
+		for (i = 0; i < n; i++) {
+			if (fe[i].nick == 0
+			    || (nick != BR_NICK_ANY && fe[i].nick != nick))
+				continue;
+			__copy_fdb_nick(&ent, fe + i);
+			if (iterator(&ent, arg))
+				return offset + i + 1;
+		}
+		offset += n;
+	}
+
+	return offset;
+}
+
+struct nick_count {
+	struct br_nick_count *nicks;	/* by nick */
+	int size;
+	int nomem;
+};
+
+static int count_nick(const struct fdb_entry_nick *f, void *arg)
+{
+	struct nick_count *nc = arg;
+
+	if (f->nick >= nc->size) {
+		int size = nc->size ? nc->size : 64;
+		struct br_nick_count *nicks;
+
+		while (size <= f->nick)
+			size *= 2;
+		nicks = realloc(nc->nicks, size * sizeof(*nicks));
+		if (!nicks) {
+			nc->nomem = 1;
+			return 1;
+		}
+		memset(nicks + nc->size, 0,
+		       (size - nc->size) * sizeof(*nicks));
+		nc->nicks = nicks;
+		nc->size = size;
+	}
+
+	++nc->nicks[f->nick].total;
+	if (f->is_local)
+		++nc->nicks[f->nick].local;
+	return 0;
+}
+
+/*
+ * Count the forwarding entries of a bridge behind each nickname,
+ * in one pass over the table, or more if it changes during one:
+ * entries are not kept. The number of restarts is stored in
+ * *retries if not NULL. *counts is sorted by nick, has the nicks
+ * with entries only and is to be freed by the caller.
+ * Returns the number of nicks or -errno.
+ */
+int br_fdb_nicks(const char *bridge, struct br_nick_count **counts,
+		 int *retries)
+{
+	struct nick_count nc = { NULL, 0, 0 };
+	int i, n, tries = 0;
+
+	/* counting starts over if the table changed meanwhile */
+	while ((n = br_foreach_fdb_nick(bridge, BR_NICK_ANY, count_nick,
+					&nc)) == -EAGAIN
+	       && ++tries < BR_DUMP_TRIES) {
+		memset(nc.nicks, 0, nc.size * sizeof(*nc.nicks));
+		br_backoff(tries - 1);
+	}
+	if (retries)
+		*retries = tries;
+	if (n < 0 || nc.nomem) {
+		free(nc.nicks);
+		return n < 0 ? n : -ENOMEM;
+	}
+
+	/* keep the nicks that have entries, in place */
+	for (i = n = 0; i < nc.size; i++) {
+		if (nc.nicks[i].total == 0)
+			continue;
+		nc.nicks[i].nick = i;
+		nc.nicks[n++] = nc.nicks[i];
+	}
+
+	*counts = nc.nicks;
 	return n;
 }
 
@@ -491,40 +1519,206 @@ int br_set_trill_state(const char *br, int trill_state)
 		      BRCTL_SET_BRIDGE_TRILL_STATE);
 }
 
+/*
+ * The kernel keeps a vni as a label: its upper 12 bits are moved
+ * up by 4, above the lower 12.
+ */
+u_int32_t br_vni_label(u_int32_t vni)
+{
+	return ((vni & 0x00FFF000) << 4) | (vni & 0x00000FFF);
+}
+
+u_int32_t br_label_vni(u_int32_t label)
+{
+	return ((label & 0x0FFF0000) >> 4) | (label & 0x00000FFF);
+}
+
 int br_set_trill_vni(const char *br, const char *p , int vni)
 {
 	int ret;
-	int index = get_portno(br, p);
-	/* fallback to old ioctl */
-	if (index < 0)
-		ret = index;
-	else {
-		struct ifreq ifr;
-		unsigned long args[4] = { BRCTL_SET_BRIDGE_TRILL_PORT_VNI, index,
-			(int)vni, 0 };
-		strncpy(ifr.ifr_name, br, IFNAMSIZ);
-		ifr.ifr_data = (char *) &args;
-		ret=ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
-	}
+
+	ret = port_ioctl(br, p, BRCTL_SET_BRIDGE_TRILL_PORT_VNI, (int)vni);
 	return ret < 0 ? errno : 0;
 }
 
-int vs_get_port_list(const char *brname, u_int32_t *ifindex)
+/*
+ * Set the vni of n ports of a bridge: the port list is read once,
+ * then there is one ioctl per port. Each entry gets its own error,
+ * 0 or errno. Returns the number of ports that failed, or -errno
+ * if the port list could not be read.
+ */
+int br_set_trill_vnis(const char *br, struct br_port_vni *pv, int n)
+{
+	int i, index, failed = 0;
+
+	if (port_cache_fill(br) < 0)
+		return -errno;
+
+	for (i = 0; i < n; i++) {
+		index = get_portno(br, pv[i].port);
+		if (index < 0 || portno_ioctl(br, index,
+					      BRCTL_SET_BRIDGE_TRILL_PORT_VNI,
+					      pv[i].vni) < 0)
+			pv[i].error = errno;
+		else
+			pv[i].error = 0;
+		failed += pv[i].error != 0;
+	}
+
+	return failed;
+}
+
+static int vs_read(const char *brname, u_int32_t *ifindex, int num)
 {
-	int ret;
 	unsigned long args[4] = { BRCTL_GET_VS_PORT_LIST,
-		(unsigned long)ifindex, MAX_PORTS };
+		(unsigned long)ifindex, num };
 	struct ifreq ifr;
-	memset(ifindex, 0, sizeof(ifindex));
+
+	memset(ifindex, 0, num * sizeof(u_int32_t));
 	strncpy(ifr.ifr_name, brname, IFNAMSIZ);
 	ifr.ifr_data = (char *) &args;
-	ret=ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
-	if ( ret< 0) {
+	return ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
+}
+
+/*
+ * Raw BRCTL_GET_VS_PORT_LIST result, at most MAX_PORTS words:
+ * each vni label is followed by its ifindexes and VS_SEPARATOR.
+ * Use br_vni_table_get() rather, which has no such limit.
+ */
+int vs_get_port_list(const char *brname, u_int32_t *ifindex)
+{
+	int ret = vs_read(brname, ifindex, MAX_PORTS);
+
+	if (ret < 0)
 		dprintf("get_portno: get ports of %s failed: %s\n",
 			brname, strerror(errno));
-		goto error;
-	}
 	return ret;
-error:
-       return -1;
-}
\ No newline at end of file
+}
+
+/* largest list asked for, in words */
+#define VS_MAX_WORDS	(1 << 24)
+
+static int compare_vnis(const void *a, const void *b)
+{
+	const struct br_vni *v0 = a, *v1 = b;
+
+	return v0->vni < v1->vni ? -1 : v0->vni > v1->vni;
+}
+
+static int compare_vni_ports(const void *a, const void *b)
+{
+	const struct br_vni_port *p0 = a, *p1 = b;
+
+	return p0->ifindex - p1->ifindex;
+}
+
+/*
+ * Get the virtual networks of a bridge and their ports, asking
+ * again with a larger buffer until the whole list fits.
+ * Returns NULL with errno set on failure.
+ */
+struct br_vni_table *br_vni_table_get(const char *bridge)
+{
+	struct br_vni_table *t;
+	u_int32_t *buf = NULL, *p;
+	int num, n, i, j, nvnis = 0, nports = 0, err;
+
+	for (num = MAX_PORTS; ; num *= 2) {
+		p = realloc(buf, num * sizeof(u_int32_t));
+		if (!p) {
+			err = ENOMEM;
+			goto fail;
+		}
+		buf = p;
+
+		n = vs_read(bridge, buf, num);
+		if (n < 0) {
+			err = errno;
+			goto fail;
+		}
+		/* a full buffer may have been cut short */
+		if (n < num || num >= VS_MAX_WORDS)
+			break;
+	}
+	if (n > num)
+		n = num;
+
+	for (i = 0; i < n; i++) {
+		++nvnis;
+		for (++i; i < n && buf[i] != VS_SEPARATOR; i++)
+			if (buf[i])
+				++nports;
+	}
+
+	/* one allocation: header, vnis, ports, then ports by ifindex */
+	t = malloc(sizeof(*t) + nvnis * sizeof(struct br_vni)
+		   + nports * (sizeof(int) + sizeof(struct br_vni_port)));
+	if (!t) {
+		err = ENOMEM;
+		goto fail;
+	}
+	t->vnis = (struct br_vni *) (t + 1);
+	t->by_port = (struct br_vni_port *) (t->vnis + nvnis);
+	t->ports = (int *) (t->by_port + nports);
+	t->nvnis = 0;
+	t->nports = 0;
+
+	for (i = 0; i < n; i++) {
+		struct br_vni *v = t->vnis + t->nvnis++;
+
+		v->vni = br_label_vni(buf[i]);
+		v->first_port = t->nports;
+		for (++i; i < n && buf[i] != VS_SEPARATOR; i++)
+			if (buf[i])
+				t->ports[t->nports++] = buf[i];
+		v->nports = t->nports - v->first_port;
+	}
+	free(buf);
+
+	qsort(t->vnis, t->nvnis, sizeof(struct br_vni), compare_vnis);
+
+	for (i = 0; i < t->nvnis; i++) {
+		const struct br_vni *v = t->vnis + i;
+
+		for (j = 0; j < v->nports; j++) {
+			t->by_port[v->first_port + j].ifindex =
+				t->ports[v->first_port + j];
+			t->by_port[v->first_port + j].vni = v->vni;
+		}
+	}
+	qsort(t->by_port, t->nports, sizeof(struct br_vni_port),
+	      compare_vni_ports);
+
+	return t;
+
+fail:
+	free(buf);
+	errno = err;
+	return NULL;
+}
+
+/* The virtual network vni, or NULL */
+const struct br_vni *br_vni_lookup(const struct br_vni_table *t,
+				   u_int32_t vni)
+{
+	struct br_vni key = { .vni = vni };
+
+	return bsearch(&key, t->vnis, t->nvnis, sizeof(struct br_vni),
+		       compare_vnis);
+}
+
+/* The vni of port ifindex, or -1 if it has none */
+int br_vni_of_port(const struct br_vni_table *t, int ifindex)
+{
+	struct br_vni_port key = { .ifindex = ifindex };
+	const struct br_vni_port *p;
+
+	p = bsearch(&key, t->by_port, t->nports, sizeof(struct br_vni_port),
+		    compare_vni_ports);
+	return p ? p->vni : -1;
+}
+
+void br_vni_table_free(struct br_vni_table *t)
+{
+	free(t);
+}
@@ -70,7 +70,7 @@ int br_add_interface(const char *bridge, const char *dev)
 {
 	struct ifreq ifr;
 	int err;
-	int ifindex = if_nametoindex(dev);
+	int ifindex = br_if_nametoindex(dev);
 
 	if (ifindex == 0) 
 		return ENODEV;
@@ -88,6 +88,7 @@ int br_add_interface(const char *bridge, const char *dev)
 		err = ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
 	}
 
+	br_port_cache_flush();
 	return err < 0 ? errno : 0;
 }
 
@@ -95,7 +96,7 @@ int br_del_interface(const char *bridge, const char *dev)
 {
 	struct ifreq ifr;
 	int err;
-	int ifindex = if_nametoindex(dev);
+	int ifindex = br_if_nametoindex(dev);
 
 	if (ifindex == 0) 
 		return ENODEV;
@@ -113,5 +114,6 @@ int br_del_interface(const char *bridge, const char *dev)
 		err = ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
 	}
 
+	br_port_cache_flush();
 	return err < 0 ? errno : 0;
 }
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "libbridge.h"
+#include "libbridge_private.h"
+
+/*
+ * Interface names and indexes, read with one link dump. A socket
+ * listening to link notifications tells when they may have changed:
+ * anything waiting on it and the table is read again.
+ */
+static struct {
+	pthread_mutex_t lock;
+	int fd;				/* RTNLGRP_LINK, non-blocking */
+	int valid;
+	unsigned int gen;		/* bumped on every change seen */
+	struct br_link *by_index;	/* sorted by ifindex */
+	struct br_link **by_name;	/* sorted by name */
+	int count;
+} ifc = { PTHREAD_MUTEX_INITIALIZER, -1 };
+
+static int compare_index(const void *_l0, const void *_l1)
+{
+	const struct br_link *l0 = _l0;
+	const struct br_link *l1 = _l1;
+
+	return l0->ifindex - l1->ifindex;
+}
+
+static int compare_name(const void *_l0, const void *_l1)
+{
+	const struct br_link *const *l0 = _l0;
+	const struct br_link *const *l1 = _l1;
+
+	return strncmp((*l0)->name, (*l1)->name, IFNAMSIZ);
+}
+
+static int ifc_listen(void)
+{
+	int group = RTNLGRP_LINK;
+	int fd = rtnl_open();
+
+	if (fd < 0)
+		return fd;
+
+	if (setsockopt(fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+		       &group, sizeof(group)) < 0
+	    || fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+		int err = errno;
+
+		close(fd);
+		return -err;
+	}
+	return fd;
+}
+
+/* Note what changed since last time; called with ifc.lock held */
+static int ifc_drain(void)
+{
+	char buf[8192];
+	int n, changed = 0;
+
+	if (ifc.fd < 0) {
+		/* listen first, so no change after the dump is missed */
+		ifc.fd = ifc_listen();
+		if (ifc.fd < 0) {
+			n = ifc.fd;
+			ifc.fd = -1;
+			return n;
+		}
+		changed = 1;
+	}
+
+	/* the contents do not matter, only that something changed */
+	for (;;) {
+		n = recv(ifc.fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (n > 0 || (n < 0 && errno == ENOBUFS))
+			changed = 1;
+		else if (n < 0 && errno == EINTR)
+			continue;
+		else
+			break;
+	}
+
+	if (changed) {
+		ifc.valid = 0;
+		if (++ifc.gen == 0)
+			++ifc.gen;
+	}
+	return 0;
+}
+
+/* Make the table current; called with ifc.lock held. Returns 0 or -errno */
+static int ifc_update(void)
+{
+	struct br_link *links;
+	struct br_link **names;
+	int i, n;
+
+	n = ifc_drain();
+	if (n < 0)
+		return n;
+
+	if (ifc.valid)
+		return 0;
+
+	n = rtnl_get_links(0, &links);
+	if (n < 0)
+		return n;
+
+	names = malloc((n + 1) * sizeof(struct br_link *));
+	if (!names) {
+		free(links);
+		return -ENOMEM;
+	}
+
+	qsort(links, n, sizeof(struct br_link), compare_index);
+	for (i = 0; i < n; i++)
+		names[i] = links + i;
+	qsort(names, n, sizeof(struct br_link *), compare_name);
+
+	free(ifc.by_index);
+	free(ifc.by_name);
+	ifc.by_index = links;
+	ifc.by_name = names;
+	ifc.count = n;
+	ifc.valid = 1;
+	return 0;
+}
+
+/*
+ * Like if_nametoindex(), from the table when it can be had.
+ * Returns 0 if there is no such interface.
+ */
+unsigned int br_if_nametoindex(const char *name)
+{
+	struct br_link key, *kp = &key, **l = NULL;
+	int ifindex = 0;
+
+	strncpy(key.name, name, IFNAMSIZ);
+
+	pthread_mutex_lock(&ifc.lock);
+	if (ifc_update() == 0) {
+		l = bsearch(&kp, ifc.by_name, ifc.count,
+			    sizeof(struct br_link *), compare_name);
+		if (l)
+			ifindex = (*l)->ifindex;
+	}
+	pthread_mutex_unlock(&ifc.lock);
+
+	/* created right now, or no rtnetlink: ask libc */
+	if (!l)
+		ifindex = if_nametoindex(name);
+	return ifindex;
+}
+
+/*
+ * Like if_indextoname(), from the table when it can be had.
+ * name has room for IFNAMSIZ bytes; returns it, or NULL.
+ */
+char *br_if_indextoname(unsigned int ifindex, char *name)
+{
+	struct br_link key, *l = NULL;
+
+	key.ifindex = ifindex;
+
+	pthread_mutex_lock(&ifc.lock);
+	if (ifc_update() == 0) {
+		l = bsearch(&key, ifc.by_index, ifc.count,
+			    sizeof(struct br_link), compare_index);
+		if (l)
+			strncpy(name, l->name, IFNAMSIZ);
+	}
+	pthread_mutex_unlock(&ifc.lock);
+
+	if (!l)
+		return if_indextoname(ifindex, name);
+	return name;
+}
+
+/*
+ * A number that changes whenever network devices may have changed,
+ * ports being added to or removed from bridges included.
+ * Returns 0 if changes can't be followed.
+ */
+unsigned int br_links_generation(void)
+{
+	unsigned int gen = 0;
+
+	pthread_mutex_lock(&ifc.lock);
+	if (ifc_drain() == 0)
+		gen = ifc.gen;
+	pthread_mutex_unlock(&ifc.lock);
+	return gen;
+}
+
+void br_ifcache_flush(void)
+{
+	pthread_mutex_lock(&ifc.lock);
+	if (ifc.fd >= 0)
+		close(ifc.fd);
+	ifc.fd = -1;
+	free(ifc.by_index);
+	free(ifc.by_name);
+	ifc.by_index = NULL;
+	ifc.by_name = NULL;
+	ifc.count = 0;
+	ifc.valid = 0;
+	pthread_mutex_unlock(&ifc.lock);
+}
@@ -24,16 +24,25 @@
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 
 #include "libbridge.h"
 #include "libbridge_private.h"
 
 int br_socket_fd = -1;
+int br_sysfs_fd = -1;
 
 int br_init(void)
 {
 	if ((br_socket_fd = socket(AF_LOCAL, SOCK_STREAM, 0)) < 0)
 		return errno;
+
+	/* rtnetlink is optional, sysfs and ioctl are used without it */
+	br_netlink_fd = rtnl_open();
+
+	/* attributes are opened relative to it, when sysfs is there */
+	br_sysfs_fd = open(SYSFS_CLASS_NET,
+			   O_RDONLY | O_DIRECTORY | O_CLOEXEC);
 	return 0;
 }
 
@@ -41,6 +50,97 @@ void br_shutdown(void)
 {
 	close(br_socket_fd);
 	br_socket_fd = -1;
+	if (br_netlink_fd >= 0)
+		close(br_netlink_fd);
+	br_netlink_fd = -1;
+	br_ifcache_flush();
+	br_fdb_snap_flush();
+	br_fdb_nick_snap_flush();
+	if (br_sysfs_fd >= 0)
+		close(br_sysfs_fd);
+	br_sysfs_fd = -1;
+}
+
+/*
+ * Link table of the rtnetlink bridge walk in progress in this thread.
+ * Links are sorted by master then name, bridges by name,
+ * so br_foreach_port can find the ports without another dump.
+ */
+static __thread struct br_link *nl_links;
+static __thread struct br_link **nl_bridges;
+static __thread int nl_nlinks, nl_nbridges;
+
+static int link_cmp(const void *_l0, const void *_l1)
+{
+	const struct br_link *l0 = _l0;
+	const struct br_link *l1 = _l1;
+
+	if (l0->master != l1->master)
+		return l0->master < l1->master ? -1 : 1;
+	return strcmp(l0->name, l1->name);
+}
+
+static int bridge_cmp(const void *_b0, const void *_b1)
+{
+	const struct br_link *const *b0 = _b0;
+	const struct br_link *const *b1 = _b1;
+
+	return strcmp((*b0)->name, (*b1)->name);
+}
+
+static int bridge_name_cmp(const void *name, const void *_b)
+{
+	const struct br_link *const *b = _b;
+
+	return strcmp(name, (*b)->name);
+}
+
+/*
+ * Use one rtnetlink dump to find bridges and their ports.
+ */
+static int nl_foreach_bridge(int (*iterator)(const char *name, void *),
+			     void *arg)
+{
+	struct br_link *links, *save_links = nl_links;
+	struct br_link **bridges, **save_bridges = nl_bridges;
+	int save_nlinks = nl_nlinks, save_nbridges = nl_nbridges;
+	int i, n, count = 0;
+
+	n = rtnl_get_links(0, &links);
+	if (n < 0)
+		return n;
+
+	qsort(links, n, sizeof(struct br_link), link_cmp);
+
+	bridges = malloc((n + 1) * sizeof(struct br_link *));
+	if (!bridges) {
+		free(links);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < n; i++)
+		if (links[i].is_bridge)
+			bridges[count++] = links + i;
+	qsort(bridges, count, sizeof(struct br_link *), bridge_cmp);
+
+	nl_links = links;
+	nl_nlinks = n;
+	nl_bridges = bridges;
+	nl_nbridges = count;
+
+	for (i = 0; i < count; i++) {
+		if (iterator(bridges[i]->name, arg))
+			break;
+	}
+
+	nl_links = save_links;
+	nl_nlinks = save_nlinks;
+	nl_bridges = save_bridges;
+	nl_nbridges = save_nbridges;
+	free(bridges);
+	free(links);
+
+	return count;
 }
 
 /* If /sys/class/net/XXX/bridge exists then it must be a bridge */
@@ -93,6 +193,51 @@ static int new_foreach_bridge(int (*iterator)(const char *name, void *),
 	return count;
 }
 
+/*
+ * The ifindexes of all bridges, with SIOCGIFBR. A full buffer may
+ * have been cut short: ask again with one twice as large, up to
+ * BR_BRIDGES_LIMIT - 1 entries. If the larger list is refused, the
+ * full one is kept. Returns number of entries in *ifindices (to be
+ * freed by caller) or -errno.
+ */
+static int get_bridge_list(int **ifindices)
+{
+	unsigned long args[3] = { BRCTL_GET_BRIDGES, 0, 0 };
+	int *buf = NULL, *p, num = MAX_BRIDGES, n, full = 0;
+
+	for (;;) {
+		p = realloc(buf, num * sizeof(int));
+		if (!p) {
+			free(buf);
+			return -ENOMEM;
+		}
+		buf = p;
+
+		args[1] = (unsigned long) buf;
+		args[2] = num;
+		n = ioctl(br_socket_fd, SIOCGIFBR, args);
+		if (n < 0 && full) {
+			n = full;
+			break;
+		}
+		if (n < 0) {
+			n = -errno;
+			free(buf);
+			return n;
+		}
+		if (n < num || num >= BR_BRIDGES_LIMIT - 1)
+			break;
+
+		full = n;
+		num *= 2;
+		if (num > BR_BRIDGES_LIMIT - 1)
+			num = BR_BRIDGES_LIMIT - 1;
+	}
+
+	*ifindices = buf;
+	return n;
+}
+
 /*
  * Old interface uses ioctl
  */
@@ -101,22 +246,21 @@ static int old_foreach_bridge(int (*iterator)(const char *, void *),
 {
 	int i, ret=0, num;
 	char ifname[IFNAMSIZ];
-	int ifindices[MAX_BRIDGES];
-	unsigned long args[3] = { BRCTL_GET_BRIDGES, 
-				 (unsigned long)ifindices, MAX_BRIDGES };
+	int *ifindices;
 
-	num = ioctl(br_socket_fd, SIOCGIFBR, args);
+	num = get_bridge_list(&ifindices);
 	if (num < 0) {
 		dprintf("Get bridge indices failed: %s\n",
-			strerror(errno));
-		return -errno;
+			strerror(-num));
+		return num;
 	}
 
 	for (i = 0; i < num; i++) {
-		if (!if_indextoname(ifindices[i], ifname)) {
+		if (!br_if_indextoname(ifindices[i], ifname)) {
 			dprintf("get find name for ifindex %d\n",
 				ifindices[i]);
-			return -errno;
+			ret = -errno;
+			break;
 		}
 
 		++ret;
@@ -125,6 +269,7 @@ static int old_foreach_bridge(int (*iterator)(const char *, void *),
 		
 	}
 
+	free(ifindices);
 	return ret;
 
 }
@@ -138,13 +283,134 @@ int br_foreach_bridge(int (*iterator)(const char *, void *),
 {
 	int ret;
 
-	ret = new_foreach_bridge(iterator, arg);
+	ret = nl_foreach_bridge(iterator, arg);
+	if (ret < 0)
+		ret = new_foreach_bridge(iterator, arg);
 	if (ret <= 0)
 		ret = old_foreach_bridge(iterator, arg);
 
 	return ret;
 }
 
+static int call_ports(const char *brname, const struct br_link *links, int n,
+		      int (*iterator)(const char *br, const char *port,
+				      void *arg),
+		      void *arg)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (iterator(brname, links[i].name, arg))
+			break;
+	}
+
+	return n;
+}
+
+/*
+ * Find ports using rtnetlink: from the table of the bridge walk
+ * in progress if there is one, otherwise with a dump filtered
+ * on the bridge.
+ */
+static int nl_foreach_port(const char *brname,
+			   int (*iterator)(const char *br, const char *port,
+					   void *arg),
+			   void *arg)
+{
+	struct br_link *links;
+	int n, ifindex;
+
+	if (nl_links) {
+		struct br_link **b;
+		int lo = 0, hi = nl_nlinks, first;
+
+		b = bsearch(brname, nl_bridges, nl_nbridges,
+			    sizeof(struct br_link *), bridge_name_cmp);
+		if (!b)
+			return -ENODEV;
+		ifindex = (*b)->ifindex;
+
+		/* links are sorted by master, find the first port */
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+
+			if (nl_links[mid].master < ifindex)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (first = lo; lo < nl_nlinks
+			     && nl_links[lo].master == ifindex; lo++)
+			;
+
+		return call_ports(brname, nl_links + first, lo - first,
+				  iterator, arg);
+	}
+
+	ifindex = br_if_nametoindex(brname);
+	if (ifindex == 0)
+		return -ENODEV;
+
+	n = rtnl_get_links(ifindex, &links);
+	if (n < 0)
+		return n;
+
+	qsort(links, n, sizeof(struct br_link), link_cmp);
+	call_ports(brname, links, n, iterator, arg);
+	free(links);
+
+	return n;
+}
+
+/*
+ * The ifindexes of the ports of a bridge, indexed by port number,
+ * with BRCTL_GET_PORT_LIST; unused numbers are 0. The kernel fills
+ * what fits and port numbers are handed out lowest first, so when
+ * the last slot is used there may be more: ask again with a buffer
+ * twice as large, up to BR_LIST_MAX. Upstream kernels fill at most
+ * BR_MAX_PORTS slots and return that count, which ends the growth.
+ * Returns the size of *ifindices (to be freed by caller) or -errno.
+ */
+int br_get_port_list(const char *brname, int **ifindices)
+{
+	unsigned long args[4] = { BRCTL_GET_PORT_LIST, 0, 0, 0 };
+	struct ifreq ifr;
+	int *buf = NULL, *p, num, n;
+
+	strncpy(ifr.ifr_name, brname, IFNAMSIZ);
+	ifr.ifr_data = (char *) &args;
+
+	for (num = MAX_PORTS; ; num *= 2) {
+		p = realloc(buf, num * sizeof(int));
+		if (!p) {
+			free(buf);
+			return -ENOMEM;
+		}
+		buf = p;
+
+		memset(buf, 0, num * sizeof(int));
+		args[1] = (unsigned long) buf;
+		args[2] = num;
+		n = ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
+		if (n < 0) {
+			int err = errno;
+
+			free(buf);
+			return -err;
+		}
+		/* fewer slots than asked for: that is all there is */
+		if (n > 0 && n < num) {
+			num = n;
+			break;
+		}
+		if (!buf[num - 1] || num >= BR_LIST_MAX)
+			break;
+	}
+
+	*ifindices = buf;
+	return num;
+}
+
 /* 
  * Only used if sysfs is not available.
  */
@@ -153,30 +419,23 @@ static int old_foreach_port(const char *brname,
 					    void *arg),
 			    void *arg)
 {
-	int i, err, count;
-	struct ifreq ifr;
+	int i, num, count;
 	char ifname[IFNAMSIZ];
-	int ifindices[MAX_PORTS];
-	unsigned long args[4] = { BRCTL_GET_PORT_LIST,
-				  (unsigned long)ifindices, MAX_PORTS, 0 };
+	int *ifindices;
 
-	memset(ifindices, 0, sizeof(ifindices));
-	strncpy(ifr.ifr_name, brname, IFNAMSIZ);
-	ifr.ifr_data = (char *) &args;
-
-	err = ioctl(br_socket_fd, SIOCDEVPRIVATE, &ifr);
-	if (err < 0) {
+	num = br_get_port_list(brname, &ifindices);
+	if (num < 0) {
 		dprintf("list ports for bridge:'%s' failed: %s\n",
-			brname, strerror(errno));
-		return -errno;
+			brname, strerror(-num));
+		return num;
 	}
 
 	count = 0;
-	for (i = 0; i < MAX_PORTS; i++) {
+	for (i = 0; i < num; i++) {
 		if (!ifindices[i])
 			continue;
 
-		if (!if_indextoname(ifindices[i], ifname)) {
+		if (!br_if_indextoname(ifindices[i], ifname)) {
 			dprintf("can't find name for ifindex:%d\n",
 				ifindices[i]);
 			continue;
@@ -187,11 +446,12 @@ static int old_foreach_port(const char *brname,
 			break;
 	}
 
+	free(ifindices);
 	return count;
 }
 	
 /*
- * Iterate over all ports in bridge (using sysfs).
+ * Iterate over all ports in bridge (using rtnetlink or sysfs).
  */
 int br_foreach_port(const char *brname,
 		    int (*iterator)(const char *br, const char *port, void *arg),
@@ -201,6 +461,10 @@ int br_foreach_port(const char *brname,
 	struct dirent **namelist;
 	char path[SYSFS_PATH_MAX];
 
+	count = nl_foreach_port(brname, iterator, arg);
+	if (count >= 0)
+		return count;
+
 	snprintf(path, SYSFS_PATH_MAX, SYSFS_CLASS_NET "%s/brif", brname);
 	count = scandir(path, &namelist, 0, alphasort);
 	if (count < 0)
@@ -19,6 +19,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/time.h>
 #include <asm/param.h>
 #include "libbridge.h"
@@ -48,3 +50,18 @@ int __get_hz(void)
 	const char * s = getenv("HZ");
 	return s ? atoi(s) : HZ;
 }
+
+/*
+ * Wait before trying a dump again: 1ms after the first failed
+ * try, doubling each time.
+ */
+void br_backoff(int retry)
+{
+	struct timespec ts;
+	long ms = 1L << (retry < 10 ? retry : 10);
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000;
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+		;
+}
@@ -0,0 +1,489 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <linux/neighbour.h>
+
+#include "libbridge.h"
+#include "libbridge_private.h"
+
+/* what the monitor knows about a network device */
+struct mon_link
+{
+	int ifindex;
+	int master;		/* bridge, if is_port */
+	unsigned port_no;
+	unsigned char state;
+	unsigned char is_port;
+	unsigned char is_bridge;
+	char name[IFNAMSIZ];
+};
+
+struct br_monitor
+{
+	int fd;
+	int brindex;		/* only events of this bridge, if non-zero */
+	struct mon_link *links;	/* sorted by ifindex */
+	int nlinks;
+	int size;
+	int (*handler)(const struct br_event *, void *);
+	void *arg;
+	int stop;
+	int count;
+	int nomem;
+	struct timeval now;
+};
+
+static struct mon_link *mon_find(struct br_monitor *m, int ifindex)
+{
+	int lo = 0, hi = m->nlinks;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (m->links[mid].ifindex == ifindex)
+			return m->links + mid;
+		if (m->links[mid].ifindex < ifindex)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+static struct mon_link *mon_add(struct br_monitor *m, int ifindex)
+{
+	struct mon_link *l;
+	int i;
+
+	if ((l = mon_find(m, ifindex)) != NULL)
+		return l;
+
+	if (m->nlinks == m->size) {
+		int size = m->size ? 2 * m->size : 64;
+
+		l = realloc(m->links, size * sizeof(struct mon_link));
+		if (!l)
+			return NULL;
+		m->links = l;
+		m->size = size;
+	}
+
+	for (i = m->nlinks; i > 0 && m->links[i - 1].ifindex > ifindex; i--)
+		;
+	memmove(m->links + i + 1, m->links + i,
+		(m->nlinks - i) * sizeof(struct mon_link));
+	++m->nlinks;
+
+	l = m->links + i;
+	memset(l, 0, sizeof(*l));
+	l->ifindex = ifindex;
+	return l;
+}
+
+static void mon_del(struct br_monitor *m, struct mon_link *l)
+{
+	int i = l - m->links;
+
+	memmove(l, l + 1, (m->nlinks - i - 1) * sizeof(struct mon_link));
+	--m->nlinks;
+}
+
+static void mon_name(struct br_monitor *m, int ifindex, char *name)
+{
+	struct mon_link *l = mon_find(m, ifindex);
+
+	if (l)
+		strncpy(name, l->name, IFNAMSIZ);
+	else if (!br_if_indextoname(ifindex, name))
+		snprintf(name, IFNAMSIZ, "if%d", ifindex);
+}
+
+static void mon_report(struct br_monitor *m, struct br_event *ev,
+		       int brindex, const struct mon_link *port)
+{
+	if (m->stop || !m->handler)
+		return;
+	if (m->brindex && brindex != m->brindex)
+		return;
+
+	ev->time = m->now;
+	mon_name(m, brindex, ev->bridge);
+	if (port)
+		strncpy(ev->port, port->name, IFNAMSIZ);
+
+	++m->count;
+	if (m->handler(ev, m->arg))
+		m->stop = 1;
+}
+
+static void port_event(struct br_monitor *m, enum br_event_type type,
+		       const struct mon_link *l, int old_state)
+{
+	struct br_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = type;
+	ev.state = l->state;
+	ev.old_state = old_state;
+	ev.fdb.port_no = l->port_no;
+	mon_report(m, &ev, l->master, l);
+}
+
+static void bridge_event(struct br_monitor *m, enum br_event_type type,
+			 const struct mon_link *l)
+{
+	struct br_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = type;
+	mon_report(m, &ev, l->ifindex, NULL);
+}
+
+/* port state and number from IFLA_PROTINFO of an AF_BRIDGE message */
+static void parse_protinfo(struct rtattr *rta, struct mon_link *l)
+{
+	struct rtattr *pi[IFLA_BRPORT_MAX + 1];
+
+	/* before 3.10 it was just the state */
+	if (RTA_PAYLOAD(rta) == sizeof(__u8)) {
+		l->state = *(__u8 *) RTA_DATA(rta);
+		return;
+	}
+
+	parse_rtattr(pi, IFLA_BRPORT_MAX, RTA_DATA(rta), RTA_PAYLOAD(rta));
+	if (pi[IFLA_BRPORT_STATE])
+		l->state = *(__u8 *) RTA_DATA(pi[IFLA_BRPORT_STATE]);
+	if (pi[IFLA_BRPORT_NO])
+		l->port_no = *(__u16 *) RTA_DATA(pi[IFLA_BRPORT_NO]);
+}
+
+static int link_msg(struct br_monitor *m, struct nlmsghdr *n)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(n);
+	struct rtattr *tb[IFLA_MAX + 1];
+	struct mon_link *l, old;
+	int len, master = 0;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+	if (len < 0)
+		return 0;
+
+	parse_rtattr(tb, IFLA_MAX, IFLA_RTA(ifi), len);
+	if (tb[IFLA_MASTER])
+		master = *(__u32 *) RTA_DATA(tb[IFLA_MASTER]);
+
+	if (n->nlmsg_type == RTM_DELLINK) {
+		l = mon_find(m, ifi->ifi_index);
+		if (!l)
+			return 0;
+
+		/* AF_BRIDGE delete: the device left its bridge */
+		if (l->is_port)
+			port_event(m, BR_EVENT_PORT_DEL, l, l->state);
+		if (ifi->ifi_family == AF_BRIDGE) {
+			l->is_port = 0;
+			return 0;
+		}
+		if (l->is_bridge)
+			bridge_event(m, BR_EVENT_BRIDGE_DEL, l);
+		mon_del(m, l);
+		return 0;
+	}
+
+	l = mon_add(m, ifi->ifi_index);
+	if (!l)
+		return -ENOMEM;
+	old = *l;
+
+	if (tb[IFLA_IFNAME])
+		strncpy(l->name, RTA_DATA(tb[IFLA_IFNAME]), IFNAMSIZ - 1);
+
+	if (ifi->ifi_family != AF_BRIDGE) {
+		if (tb[IFLA_LINKINFO]) {
+			struct rtattr *li[IFLA_INFO_MAX + 1];
+
+			parse_rtattr(li, IFLA_INFO_MAX,
+				     RTA_DATA(tb[IFLA_LINKINFO]),
+				     RTA_PAYLOAD(tb[IFLA_LINKINFO]));
+			if (li[IFLA_INFO_KIND]
+			    && !strcmp(RTA_DATA(li[IFLA_INFO_KIND]), "bridge"))
+				l->is_bridge = 1;
+		}
+		if (l->is_bridge)
+			bridge_event(m, old.is_bridge ? BR_EVENT_BRIDGE_CHANGE
+					: BR_EVENT_BRIDGE_ADD, l);
+
+		/* released without an AF_BRIDGE notification */
+		if (l->is_port && master != l->master) {
+			port_event(m, BR_EVENT_PORT_DEL, l, l->state);
+			l->is_port = 0;
+		}
+		return 0;
+	}
+
+	/* bridges with vlans report themselves too */
+	if (!master || master == ifi->ifi_index)
+		return 0;
+
+	if (tb[IFLA_PROTINFO])
+		parse_protinfo(tb[IFLA_PROTINFO], l);
+
+	if (old.is_port && old.master != master) {
+		port_event(m, BR_EVENT_PORT_DEL, &old, old.state);
+		old.is_port = 0;
+	}
+
+	l->is_port = 1;
+	l->master = master;
+	if (!old.is_port)
+		port_event(m, BR_EVENT_PORT_ADD, l, l->state);
+	else if (old.state != l->state)
+		port_event(m, BR_EVENT_PORT_STATE, l, old.state);
+
+	return 0;
+}
+
+static void neigh_msg(struct br_monitor *m, struct nlmsghdr *n)
+{
+	struct ndmsg *ndm = NLMSG_DATA(n);
+	struct rtattr *tb[NDA_MAX + 1];
+	struct mon_link *port;
+	struct br_event ev;
+	int len, brindex;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ndm));
+	if (len < 0 || ndm->ndm_family != AF_BRIDGE)
+		return;
+
+	parse_rtattr(tb, NDA_MAX, RTM_RTA(ndm), len);
+	if (!tb[NDA_MASTER] || !tb[NDA_LLADDR])
+		return;
+
+	brindex = *(__u32 *) RTA_DATA(tb[NDA_MASTER]);
+	if (ndm->ndm_ifindex == brindex)
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = n->nlmsg_type == RTM_NEWNEIGH
+		? BR_EVENT_FDB_ADD : BR_EVENT_FDB_DEL;
+	memcpy(ev.fdb.mac_addr, RTA_DATA(tb[NDA_LLADDR]), 6);
+	ev.fdb.is_local = (ndm->ndm_state & NUD_PERMANENT) != 0;
+	ev.is_static = (ndm->ndm_state & (NUD_PERMANENT | NUD_NOARP)) != 0;
+	if (tb[NDA_VLAN])
+		ev.fdb.vlan = *(__u16 *) RTA_DATA(tb[NDA_VLAN]);
+
+	port = mon_find(m, ndm->ndm_ifindex);
+	if (port) {
+		ev.fdb.port_no = port->port_no;
+		ev.state = port->state;
+		mon_report(m, &ev, brindex, port);
+	} else {
+		mon_name(m, ndm->ndm_ifindex, ev.port);
+		mon_report(m, &ev, brindex, NULL);
+	}
+}
+
+static int dump_filter(struct nlmsghdr *n, void *arg)
+{
+	struct br_monitor *m = arg;
+
+	if (link_msg(m, n) < 0) {
+		m->nomem = 1;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Learn the devices, bridge ports and their states.
+ * Nothing is reported while doing so.
+ */
+static int mon_sync(struct br_monitor *m)
+{
+	struct {
+		struct nlmsghdr n;
+		struct ifinfomsg ifi;
+	} req;
+	int fd, i, err, tries = 0;
+
+	fd = rtnl_open();
+	if (fd < 0)
+		return fd;
+
+	m->stop = 1;
+ again:
+	m->nlinks = 0;
+	m->nomem = 0;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req.n.nlmsg_type = RTM_GETLINK;
+	req.ifi.ifi_family = AF_UNSPEC;
+	err = rtnl_dump(fd, &req.n, dump_filter, m);
+
+	if (!err) {
+		req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+		req.ifi.ifi_family = AF_BRIDGE;
+		err = rtnl_dump(fd, &req.n, dump_filter, m);
+	}
+	/* devices changed while being dumped */
+	if (err == -EAGAIN && ++tries < BR_DUMP_TRIES) {
+		br_backoff(tries - 1);
+		goto again;
+	}
+	close(fd);
+	if (!err && m->nomem)
+		err = -ENOMEM;
+
+	/* old kernels don't report IFLA_BRPORT_NO */
+	for (i = 0; i < m->nlinks; i++)
+		if (m->links[i].is_port && m->links[i].port_no == 0)
+			m->links[i].port_no = sysfs_port_no(m->links[i].name);
+
+	m->stop = 0;
+	return err;
+}
+
+/*
+ * Start listening to link and forwarding database changes
+ * of bridge, or of all bridges if NULL.
+ * Returns NULL with errno set on failure.
+ */
+struct br_monitor *br_monitor_open(const char *bridge)
+{
+	static const int groups[] = { RTNLGRP_LINK, RTNLGRP_NEIGH };
+	struct br_monitor *m;
+	int i, err;
+
+	m = calloc(1, sizeof(*m));
+	if (!m) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	m->fd = rtnl_open();
+	if (m->fd < 0) {
+		err = -m->fd;
+		goto fail;
+	}
+
+	/* subscribe before reading the state, so nothing is missed */
+	for (i = 0; i < sizeof(groups)/sizeof(groups[0]); i++) {
+		if (setsockopt(m->fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+			       &groups[i], sizeof(groups[i])) < 0) {
+			err = errno;
+			goto fail;
+		}
+	}
+
+	err = -mon_sync(m);
+	if (err)
+		goto fail;
+
+	if (bridge) {
+		for (i = 0; i < m->nlinks; i++)
+			if (m->links[i].is_bridge
+			    && !strncmp(m->links[i].name, bridge, IFNAMSIZ))
+				break;
+		if (i == m->nlinks) {
+			err = ENODEV;
+			goto fail;
+		}
+		m->brindex = m->links[i].ifindex;
+	}
+
+	return m;
+
+ fail:
+	br_monitor_close(m);
+	errno = err;
+	return NULL;
+}
+
+/* For poll/select: readable when br_monitor_dispatch has work */
+int br_monitor_fd(const struct br_monitor *m)
+{
+	return m->fd;
+}
+
+/*
+ * Read one batch of notifications and pass the resulting events
+ * to handler, until it returns non-zero. Blocks unless the
+ * descriptor is non-blocking. If the kernel dropped notifications
+ * the state is read again and -ENOBUFS returned: events were lost.
+ * Returns number of events passed to handler or -errno.
+ */
+int br_monitor_dispatch(struct br_monitor *m,
+			int (*handler)(const struct br_event *, void *),
+			void *arg)
+{
+	char buf[32768];
+	struct nlmsghdr *n;
+	int len, err = 0;
+
+	len = recv(m->fd, buf, sizeof(buf), 0);
+	if (len < 0) {
+		if (errno == ENOBUFS) {
+			err = mon_sync(m);
+			return err ? err : -ENOBUFS;
+		}
+		return -errno;
+	}
+
+	gettimeofday(&m->now, NULL);
+	m->handler = handler;
+	m->arg = arg;
+	m->stop = 0;
+	m->count = 0;
+
+	for (n = (struct nlmsghdr *) buf; NLMSG_OK(n, len);
+	     n = NLMSG_NEXT(n, len)) {
+		switch (n->nlmsg_type) {
+		case RTM_NEWLINK:
+		case RTM_DELLINK:
+			if (link_msg(m, n) < 0)
+				err = -ENOMEM;
+			break;
+		case RTM_NEWNEIGH:
+		case RTM_DELNEIGH:
+			neigh_msg(m, n);
+			break;
+		}
+	}
+
+	m->handler = NULL;
+	return err ? err : m->count;
+}
+
+void br_monitor_close(struct br_monitor *m)
+{
+	if (m->fd >= 0)
+		close(m->fd);
+	free(m->links);
+	free(m);
+}
@@ -0,0 +1,575 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <linux/neighbour.h>
+
+#include "libbridge.h"
+#include "libbridge_private.h"
+
+int br_netlink_fd = -1;
+static __u32 rtnl_seq;
+
+/* one dump at a time on br_netlink_fd, shared between threads */
+static pthread_mutex_t rtnl_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int rtnl_open(void)
+{
+	struct sockaddr_nl local;
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (fd < 0)
+		return -errno;
+
+	memset(&local, 0, sizeof(local));
+	local.nl_family = AF_NETLINK;
+	if (bind(fd, (struct sockaddr *) &local, sizeof(local)) < 0) {
+		int err = errno;
+
+		close(fd);
+		return -err;
+	}
+
+	return fd;
+}
+
+void parse_rtattr(struct rtattr *tb[], int max, struct rtattr *rta, int len)
+{
+	memset(tb, 0, sizeof(struct rtattr *) * (max + 1));
+	while (RTA_OK(rta, len)) {
+		unsigned short type = rta->rta_type & ~NLA_F_NESTED;
+
+		if (type <= max)
+			tb[type] = rta;
+		rta = RTA_NEXT(rta, len);
+	}
+}
+
+int addattr32(struct nlmsghdr *n, int maxlen, int type, __u32 data)
+{
+	int len = RTA_LENGTH(sizeof(data));
+	struct rtattr *rta;
+
+	if (NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(len) > maxlen)
+		return -1;
+
+	rta = (struct rtattr *) (((char *) n) + NLMSG_ALIGN(n->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = len;
+	memcpy(RTA_DATA(rta), &data, sizeof(data));
+	n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(len);
+	return 0;
+}
+
+/*
+ * Send a request and hand every reply to filter, until the
+ * kernel is done (NLMSG_DONE for dumps, an ack otherwise).
+ * Requests on br_netlink_fd hold rtnl_lock, so their filter must
+ * not make another request; if it returns non-zero the rest of the
+ * replies is read but no longer passed on, so the socket stays
+ * usable. A socket of its own from rtnl_open() is not locked, its
+ * filter may call into libbridge, and the rest of the replies is
+ * left unread (later requests skip them by sequence number).
+ * Returns 0 or -errno, -EAGAIN if the kernel flagged a dump as
+ * interrupted: what was dumped changed meanwhile and filter may
+ * have seen entries twice or missed some.
+ */
+static int rtnl_request(int fd, struct nlmsghdr *req, int flags,
+			int (*filter)(struct nlmsghdr *n, void *arg),
+			void *arg)
+{
+	struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+	char buf[32768];
+	int shared = fd == br_netlink_fd;
+	int stop = 0, intr = 0, err;
+	__u32 seq;
+
+	if (shared)
+		pthread_mutex_lock(&rtnl_lock);
+
+	req->nlmsg_flags |= NLM_F_REQUEST | flags;
+	req->nlmsg_seq = seq = __sync_add_and_fetch(&rtnl_seq, 1);
+
+	if (sendto(fd, req, req->nlmsg_len, 0,
+		   (struct sockaddr *) &nladdr, sizeof(nladdr)) < 0) {
+		err = -errno;
+		goto out;
+	}
+
+	for (;;) {
+		struct nlmsghdr *n;
+		int len;
+
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			goto out;
+		}
+		if (len == 0) {
+			err = -ENODATA;
+			goto out;
+		}
+
+		for (n = (struct nlmsghdr *) buf; NLMSG_OK(n, len);
+		     n = NLMSG_NEXT(n, len)) {
+			if (n->nlmsg_seq != seq)
+				continue;
+
+			if (n->nlmsg_flags & NLM_F_DUMP_INTR)
+				intr = 1;
+
+			if (n->nlmsg_type == NLMSG_DONE) {
+				err = intr ? -EAGAIN : 0;
+				goto out;
+			}
+
+			if (n->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *e = NLMSG_DATA(n);
+
+				/* 0 is the ack of a request */
+				err = e->error;
+				goto out;
+			}
+
+			if (!stop && filter(n, arg)) {
+				stop = 1;
+				if (!shared) {
+					err = 0;
+					goto out;
+				}
+			}
+		}
+	}
+
+ out:
+	if (shared)
+		pthread_mutex_unlock(&rtnl_lock);
+	return err;
+}
+
+/* Send a dump request, see rtnl_request */
+int rtnl_dump(int fd, struct nlmsghdr *req,
+	      int (*filter)(struct nlmsghdr *n, void *arg), void *arg)
+{
+	return rtnl_request(fd, req, NLM_F_DUMP, filter, arg);
+}
+
+struct link_dump {
+	struct br_link *links;
+	int count;
+	int size;
+	int master;
+	int nomem;
+};
+
+static int link_filter(struct nlmsghdr *n, void *arg)
+{
+	struct link_dump *d = arg;
+	struct ifinfomsg *ifi = NLMSG_DATA(n);
+	struct rtattr *tb[IFLA_MAX + 1];
+	struct br_link *l;
+	int len;
+
+	if (n->nlmsg_type != RTM_NEWLINK)
+		return 0;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+	if (len < 0)
+		return 0;
+
+	parse_rtattr(tb, IFLA_MAX, IFLA_RTA(ifi), len);
+	if (!tb[IFLA_IFNAME])
+		return 0;
+
+	if (d->master && (!tb[IFLA_MASTER]
+			  || *(__u32 *) RTA_DATA(tb[IFLA_MASTER]) != d->master))
+		return 0;
+
+	if (d->count == d->size) {
+		struct br_link *nl;
+
+		d->size = d->size ? 2 * d->size : 64;
+		nl = realloc(d->links, d->size * sizeof(struct br_link));
+		if (!nl) {
+			d->nomem = 1;
+			return 1;
+		}
+		d->links = nl;
+	}
+
+	l = d->links + d->count++;
+	memset(l, 0, sizeof(*l));
+	l->ifindex = ifi->ifi_index;
+	strncpy(l->name, RTA_DATA(tb[IFLA_IFNAME]), IFNAMSIZ - 1);
+	if (tb[IFLA_MASTER])
+		l->master = *(__u32 *) RTA_DATA(tb[IFLA_MASTER]);
+
+	if (tb[IFLA_LINKINFO]) {
+		struct rtattr *li[IFLA_INFO_MAX + 1];
+
+		parse_rtattr(li, IFLA_INFO_MAX, RTA_DATA(tb[IFLA_LINKINFO]),
+			     RTA_PAYLOAD(tb[IFLA_LINKINFO]));
+		if (li[IFLA_INFO_KIND]
+		    && strcmp(RTA_DATA(li[IFLA_INFO_KIND]), "bridge") == 0)
+			l->is_bridge = 1;
+
+		if (li[IFLA_INFO_SLAVE_KIND] && li[IFLA_INFO_SLAVE_DATA]
+		    && strcmp(RTA_DATA(li[IFLA_INFO_SLAVE_KIND]), "bridge") == 0) {
+			struct rtattr *pi[IFLA_BRPORT_MAX + 1];
+
+			parse_rtattr(pi, IFLA_BRPORT_MAX,
+				     RTA_DATA(li[IFLA_INFO_SLAVE_DATA]),
+				     RTA_PAYLOAD(li[IFLA_INFO_SLAVE_DATA]));
+			if (pi[IFLA_BRPORT_NO])
+				l->port_no = *(__u16 *) RTA_DATA(pi[IFLA_BRPORT_NO]);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Read all network devices with one RTM_GETLINK dump.
+ * If master is non-zero only devices enslaved to it are returned
+ * (newer kernels filter themselves, older ones are filtered here).
+ * Returns number of entries in *links (to be freed by caller)
+ * or -errno.
+ */
+int rtnl_get_links(int master, struct br_link **links)
+{
+	struct {
+		struct nlmsghdr n;
+		struct ifinfomsg ifi;
+		char buf[64];
+	} req;
+	struct link_dump d = { .master = master };
+	int err, tries = 0;
+
+	if (br_netlink_fd < 0)
+		return -EOPNOTSUPP;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req.n.nlmsg_type = RTM_GETLINK;
+	req.ifi.ifi_family = AF_UNSPEC;
+	if (master)
+		addattr32(&req.n, sizeof(req), IFLA_MASTER, master);
+
+	while ((err = rtnl_dump(br_netlink_fd, &req.n, link_filter, &d))
+	       == -EAGAIN && ++tries < BR_DUMP_TRIES) {
+		free(d.links);
+		memset(&d, 0, sizeof(d));
+		d.master = master;
+		br_backoff(tries - 1);
+	}
+	if (err == 0 && d.nomem)
+		err = -ENOMEM;
+	if (err) {
+		free(d.links);
+		return err;
+	}
+
+	*links = d.links;
+	return d.count;
+}
+
+static int ifindex_cmp(const void *_l0, const void *_l1)
+{
+	const struct br_link *l0 = _l0;
+	const struct br_link *l1 = _l1;
+
+	return l0->ifindex - l1->ifindex;
+}
+
+/*
+ * Forwarding entry dumps are resumed by index and the kernel does
+ * not flag them as interrupted, so changes are watched for on a
+ * socket subscribed to RTNLGRP_NEIGH during the dump.
+ */
+static int fdb_watch_open(void)
+{
+	int group = RTNLGRP_NEIGH;
+	int fd;
+
+	fd = rtnl_open();
+	if (fd < 0)
+		return fd;
+	if (setsockopt(fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+		       &group, sizeof(group)) < 0) {
+		int err = errno;
+
+		close(fd);
+		return -err;
+	}
+	return fd;
+}
+
+/* 1 if an entry of bridge brindex changed since fd was opened */
+static int fdb_watch_changed(int fd, int brindex)
+{
+	char buf[8192];
+	int len;
+
+	for (;;) {
+		struct nlmsghdr *n;
+
+		len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			/* ENOBUFS: notifications were lost */
+			return errno != EAGAIN && errno != EWOULDBLOCK;
+		}
+
+		for (n = (struct nlmsghdr *) buf; NLMSG_OK(n, len);
+		     n = NLMSG_NEXT(n, len)) {
+			struct ndmsg *ndm = NLMSG_DATA(n);
+			struct rtattr *tb[NDA_MAX + 1];
+			int alen;
+
+			if (n->nlmsg_type != RTM_NEWNEIGH
+			    && n->nlmsg_type != RTM_DELNEIGH)
+				continue;
+			alen = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ndm));
+			if (alen < 0 || ndm->ndm_family != AF_BRIDGE)
+				continue;
+
+			parse_rtattr(tb, NDA_MAX, RTM_RTA(ndm), alen);
+			if (!tb[NDA_MASTER]
+			    || *(__u32 *) RTA_DATA(tb[NDA_MASTER]) == brindex)
+				return 1;
+		}
+	}
+}
+
+/* entries read between two looks at the notifications */
+#define FDB_WATCH_EVERY	256
+
+struct fdb_dump {
+	int brindex;
+	struct br_link *ports;
+	int nports;
+	int count;
+	int stopped;
+	int watch;			/* socket of fdb_watch_open() */
+	int changed;
+	int (*iterator)(const struct fdb_entry *, void *);
+	void *arg;
+};
+
+/*
+ * Convert a neighbour message to a forwarding entry of bridge brindex.
+ * Returns the ifindex of the port, or 0 if the message is not
+ * such an entry (the bridge's own addresses are not).
+ */
+static int fdb_parse(struct nlmsghdr *n, int brindex, struct fdb_entry *ent)
+{
+	struct ndmsg *ndm = NLMSG_DATA(n);
+	struct rtattr *tb[NDA_MAX + 1];
+	int len;
+
+	if (n->nlmsg_type != RTM_NEWNEIGH)
+		return 0;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ndm));
+	if (len < 0 || ndm->ndm_family != AF_BRIDGE)
+		return 0;
+
+	parse_rtattr(tb, NDA_MAX, RTM_RTA(ndm), len);
+
+	/* only entries of this bridge, and not its own address */
+	if (!tb[NDA_MASTER] || !tb[NDA_LLADDR]
+	    || *(__u32 *) RTA_DATA(tb[NDA_MASTER]) != brindex
+	    || ndm->ndm_ifindex == brindex)
+		return 0;
+
+	memset(ent, 0, sizeof(*ent));
+	memcpy(ent->mac_addr, RTA_DATA(tb[NDA_LLADDR]), 6);
+	ent->is_local = (ndm->ndm_state & NUD_PERMANENT) != 0;
+	if (tb[NDA_VLAN])
+		ent->vlan = *(__u16 *) RTA_DATA(tb[NDA_VLAN]);
+	/* like brforward, static entries have no ageing timer */
+	if (tb[NDA_CACHEINFO]
+	    && !(ndm->ndm_state & (NUD_PERMANENT | NUD_NOARP))) {
+		struct nda_cacheinfo *ci = RTA_DATA(tb[NDA_CACHEINFO]);
+
+		__jiffies_to_tv(&ent->ageing_timer_value, ci->ndm_updated);
+	}
+
+	return ndm->ndm_ifindex;
+}
+
+static int fdb_filter(struct nlmsghdr *n, void *arg)
+{
+	struct fdb_dump *d = arg;
+	struct br_link key, *port;
+	struct fdb_entry ent;
+
+	key.ifindex = fdb_parse(n, d->brindex, &ent);
+	if (!key.ifindex)
+		return 0;
+
+	port = bsearch(&key, d->ports, d->nports, sizeof(struct br_link),
+		       ifindex_cmp);
+	ent.port_no = port ? port->port_no : 0;
+
+	/* now and then, so that notifications don't pile up */
+	if (d->count % FDB_WATCH_EVERY == 0
+	    && fdb_watch_changed(d->watch, d->brindex)) {
+		d->changed = 1;
+		return 1;
+	}
+
+	++d->count;
+	d->stopped = d->iterator(&ent, d->arg);
+	return d->stopped;
+}
+
+/*
+ * Walk the forwarding database of a bridge with one RTM_GETNEIGH
+ * dump; port numbers come from a link dump of the bridge ports.
+ * The dump has a socket of its own, so iterator runs as the
+ * replies come in, one receive buffer at a time, and may make
+ * requests of its own. Stops when iterator returns non-zero.
+ * Returns number of entries seen or -errno, -EAGAIN if entries of
+ * the bridge were added, changed or removed during a whole walk.
+ */
+int rtnl_foreach_fdb(int brindex,
+		     int (*iterator)(const struct fdb_entry *, void *),
+		     void *arg)
+{
+	struct {
+		struct nlmsghdr n;
+		struct ifinfomsg ifm;
+		char buf[64];
+	} req;
+	struct fdb_dump d = { .brindex = brindex, .iterator = iterator,
+			      .arg = arg };
+	int i, fd, err;
+
+	d.nports = rtnl_get_links(brindex, &d.ports);
+	if (d.nports < 0)
+		return d.nports;
+
+	/* old kernels don't report IFLA_BRPORT_NO */
+	for (i = 0; i < d.nports; i++)
+		if (d.ports[i].port_no == 0)
+			d.ports[i].port_no = sysfs_port_no(d.ports[i].name);
+	qsort(d.ports, d.nports, sizeof(struct br_link), ifindex_cmp);
+
+	d.watch = fdb_watch_open();
+	if (d.watch < 0) {
+		free(d.ports);
+		return d.watch;
+	}
+	fd = rtnl_open();
+	if (fd < 0) {
+		close(d.watch);
+		free(d.ports);
+		return fd;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req.n.nlmsg_type = RTM_GETNEIGH;
+	req.ifm.ifi_family = PF_BRIDGE;
+	addattr32(&req.n, sizeof(req), IFLA_MASTER, brindex);
+
+	err = rtnl_dump(fd, &req.n, fdb_filter, &d);
+	if (!err && !d.stopped
+	    && (d.changed || fdb_watch_changed(d.watch, brindex)))
+		err = -EAGAIN;
+	close(fd);
+	close(d.watch);
+	free(d.ports);
+
+	return err ? err : d.count;
+}
+
+struct fdb_get {
+	int brindex;
+	int ifindex;
+	struct fdb_entry *ent;
+};
+
+static int fdb_get_filter(struct nlmsghdr *n, void *arg)
+{
+	struct fdb_get *g = arg;
+
+	g->ifindex = fdb_parse(n, g->brindex, g->ent);
+	return g->ifindex != 0;
+}
+
+/*
+ * Look up one forwarding entry with a RTM_GETNEIGH request
+ * (Linux 5.0 and later).
+ * Returns 0, -ENOENT if there is no such entry, or -errno
+ * (-EOPNOTSUPP, -EINVAL...) if the kernel can't answer.
+ */
+int rtnl_fdb_get(int brindex, const unsigned char *mac,
+		 struct fdb_entry *ent)
+{
+	struct {
+		struct nlmsghdr n;
+		struct ndmsg ndm;
+		char buf[64];
+	} req;
+	struct fdb_get g = { .brindex = brindex, .ent = ent };
+	struct rtattr *rta;
+	char ifname[IFNAMSIZ];
+	int err;
+
+	if (br_netlink_fd < 0)
+		return -EOPNOTSUPP;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct ndmsg));
+	req.n.nlmsg_type = RTM_GETNEIGH;
+	req.ndm.ndm_family = AF_BRIDGE;
+	addattr32(&req.n, sizeof(req), NDA_MASTER, brindex);
+
+	rta = (struct rtattr *) (((char *) &req.n)
+				 + NLMSG_ALIGN(req.n.nlmsg_len));
+	rta->rta_type = NDA_LLADDR;
+	rta->rta_len = RTA_LENGTH(6);
+	memcpy(RTA_DATA(rta), mac, 6);
+	req.n.nlmsg_len = NLMSG_ALIGN(req.n.nlmsg_len)
+		+ RTA_ALIGN(rta->rta_len);
+
+	err = rtnl_request(br_netlink_fd, &req.n, NLM_F_ACK,
+			   fdb_get_filter, &g);
+	if (err)
+		return err;
+	if (!g.ifindex)
+		return -ENOENT;
+
+	if (br_if_indextoname(g.ifindex, ifname))
+		ent->port_no = sysfs_port_no(ifname);
+	return 0;
+}
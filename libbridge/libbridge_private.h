@@ -25,16 +25,59 @@
 #include <sys/time.h>
 #include <sys/ioctl.h>
 #include <linux/if_bridge.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 
+/* first size of ioctl lists, grown as needed up to BR_LIST_MAX */
 #define MAX_BRIDGES	1024
 #define MAX_PORTS	1024
+#define BR_LIST_MAX	65536
+/* the kernel refuses BRCTL_GET_BRIDGES lists this long or longer */
+#define BR_BRIDGES_LIMIT	2048
 
 #define SYSFS_CLASS_NET "/sys/class/net/"
 #define SYSFS_PATH_MAX	256
 
 #define dprintf(fmt,arg...)
 
+/* older headers */
+#ifndef NLM_F_DUMP_INTR
+#define NLM_F_DUMP_INTR	0x10
+#endif
+
 extern int br_socket_fd;
+extern int br_netlink_fd;
+extern int br_sysfs_fd;
+
+/* network device as seen by an rtnetlink link dump */
+struct br_link
+{
+	int ifindex;
+	int master;
+	unsigned port_no;
+	unsigned char is_bridge;
+	char name[IFNAMSIZ];
+};
+
+extern int rtnl_open(void);
+extern int rtnl_dump(int fd, struct nlmsghdr *req,
+		     int (*filter)(struct nlmsghdr *n, void *arg), void *arg);
+extern void parse_rtattr(struct rtattr *tb[], int max,
+			 struct rtattr *rta, int len);
+extern int addattr32(struct nlmsghdr *n, int maxlen, int type, __u32 data);
+extern int rtnl_get_links(int master, struct br_link **links);
+extern int rtnl_foreach_fdb(int brindex,
+			    int (*iterator)(const struct fdb_entry *, void *),
+			    void *arg);
+extern int rtnl_fdb_get(int brindex, const unsigned char *mac,
+			struct fdb_entry *ent);
+extern int sysfs_port_no(const char *port);
+extern int br_get_port_list(const char *brname, int **ifindices);
+extern void br_port_cache_flush(void);
+extern void br_ifcache_flush(void);
+extern unsigned int br_links_generation(void);
+extern void br_fdb_snap_flush(void);
+extern void br_fdb_nick_snap_flush(void);
 
 static inline unsigned long __tv_to_jiffies(const struct timeval *tv)
 {
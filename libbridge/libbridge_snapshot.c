@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "libbridge.h"
+#include "libbridge_private.h"
+
+/* bridges and ports found so far, before they go to the arena */
+struct snap_walk {
+	struct br_snapshot_bridge *bridges;
+	int nbridges, maxbridges;
+	struct br_snapshot_port *ports;
+	int nports, maxports;
+	unsigned int flags;
+	int error;
+};
+
+static int walk_port(const char *br, const char *port, void *arg)
+{
+	struct snap_walk *w = arg;
+	struct br_snapshot_port *p;
+
+	if (w->nports == w->maxports) {
+		int size = w->maxports ? 2 * w->maxports : 64;
+
+		p = realloc(w->ports, size * sizeof(*p));
+		if (!p) {
+			w->error = ENOMEM;
+			return 1;
+		}
+		w->ports = p;
+		w->maxports = size;
+	}
+
+	p = w->ports + w->nports++;
+	memset(p, 0, sizeof(*p));
+	strncpy(p->name, port, IFNAMSIZ - 1);
+	p->bridge = w->nbridges - 1;
+	return 0;
+}
+
+static int walk_bridge(const char *name, void *arg)
+{
+	struct snap_walk *w = arg;
+	struct br_snapshot_bridge *b;
+	int err;
+
+	if (w->nbridges == w->maxbridges) {
+		int size = w->maxbridges ? 2 * w->maxbridges : 16;
+
+		b = realloc(w->bridges, size * sizeof(*b));
+		if (!b) {
+			w->error = ENOMEM;
+			return 1;
+		}
+		w->bridges = b;
+		w->maxbridges = size;
+	}
+
+	b = w->bridges + w->nbridges++;
+	memset(b, 0, sizeof(*b));
+	strncpy(b->name, name, IFNAMSIZ - 1);
+	b->first_port = w->nports;
+	b->fdb_count = -1;
+
+	if (w->flags & BR_SNAPSHOT_PORTS) {
+		err = br_foreach_port(name, walk_port, w);
+		if (w->error)
+			return 1;
+		if (err < 0)
+			b->port_error = -err;
+		b->nports = w->nports - b->first_port;
+	}
+
+	return 0;
+}
+
+static int count_fdb(const struct fdb_entry *f, void *arg)
+{
+	return 0;
+}
+
+/* bridges then ports to fill in, shared by the worker threads */
+struct snap_fill {
+	struct br_snapshot *snap;
+	unsigned int bmask, pmask, flags;
+	int count;
+	int next;
+};
+
+static void fill_one(struct snap_fill *f, int i)
+{
+	struct br_snapshot *snap = f->snap;
+
+	if (i < snap->nbridges) {
+		struct br_snapshot_bridge *b = snap->bridges + i;
+
+		b->error = br_get_bridge_info_mask(b->name, f->bmask,
+						   &b->info);
+		if ((f->flags & BR_SNAPSHOT_FDB_COUNT) && !b->error) {
+			int n, tries = 0;
+
+			while ((n = br_foreach_fdb(b->name, count_fdb, NULL))
+			       == -EAGAIN && ++tries < BR_DUMP_TRIES)
+				br_backoff(tries - 1);
+
+			if (n < 0)
+				b->fdb_error = -n;
+			else
+				b->fdb_count = n;
+		}
+	} else {
+		struct br_snapshot_port *p = snap->ports + i - snap->nbridges;
+
+		p->error = br_get_port_info_mask(snap->bridges[p->bridge].name,
+						 p->name, f->pmask, &p->info);
+	}
+}
+
+static void *fill_worker(void *arg)
+{
+	struct snap_fill *f = arg;
+	int i;
+
+	while ((i = __sync_fetch_and_add(&f->next, 1)) < f->count)
+		fill_one(f, i);
+
+	return NULL;
+}
+
+/*
+ * Capture bridges (all of them, or just brname if not NULL),
+ * optionally their ports and forwarding table sizes, in one
+ * allocation. Only the bridge and port fields in bmask and pmask
+ * are read, by up to nthreads threads; the order of bridges and
+ * ports does not depend on it. Returns NULL with errno set on failure.
+ */
+struct br_snapshot *br_snapshot_take_threads(const char *brname,
+					     unsigned int bmask,
+					     unsigned int pmask,
+					     unsigned int flags, int nthreads)
+{
+	struct snap_fill f;
+	pthread_t *tids = NULL;
+	int nworkers = 0;
+	struct snap_walk w;
+	struct br_snapshot *snap;
+	size_t bsize, psize;
+	int i;
+
+	memset(&w, 0, sizeof(w));
+	w.flags = flags;
+
+	if (brname)
+		walk_bridge(brname, &w);
+	else {
+		int err = br_foreach_bridge(walk_bridge, &w);
+
+		if (err < 0 && !w.error)
+			w.error = -err;
+	}
+
+	if (w.error)
+		goto fail;
+
+	/* one arena: header, then bridges, then ports */
+	bsize = w.nbridges * sizeof(struct br_snapshot_bridge);
+	psize = w.nports * sizeof(struct br_snapshot_port);
+	snap = malloc(sizeof(*snap) + bsize + psize);
+	if (!snap) {
+		w.error = ENOMEM;
+		goto fail;
+	}
+
+	snap->bridges = (struct br_snapshot_bridge *) (snap + 1);
+	snap->nbridges = w.nbridges;
+	snap->ports = (struct br_snapshot_port *) (snap->bridges + w.nbridges);
+	snap->nports = w.nports;
+	if (bsize)
+		memcpy(snap->bridges, w.bridges, bsize);
+	if (psize)
+		memcpy(snap->ports, w.ports, psize);
+	free(w.bridges);
+	free(w.ports);
+
+	f.snap = snap;
+	f.bmask = bmask;
+	f.pmask = pmask;
+	f.flags = flags;
+	f.count = snap->nbridges + (pmask ? snap->nports : 0);
+	f.next = 0;
+
+	if (nthreads > f.count)
+		nthreads = f.count;
+	if (nthreads > 1)
+		tids = malloc((nthreads - 1) * sizeof(pthread_t));
+
+	/* if threads can't be had, this one does the rest */
+	for (i = 0; tids && i < nthreads - 1; i++) {
+		if (pthread_create(tids + nworkers, NULL, fill_worker, &f))
+			break;
+		++nworkers;
+	}
+
+	fill_worker(&f);
+
+	for (i = 0; i < nworkers; i++)
+		pthread_join(tids[i], NULL);
+	free(tids);
+
+	return snap;
+
+fail:
+	free(w.bridges);
+	free(w.ports);
+	errno = w.error;
+	return NULL;
+}
+
+struct br_snapshot *br_snapshot_take(const char *brname, unsigned int bmask,
+				     unsigned int pmask, unsigned int flags)
+{
+	return br_snapshot_take_threads(brname, bmask, pmask, flags, 1);
+}
+
+void br_snapshot_free(struct br_snapshot *snap)
+{
+	free(snap);
+}
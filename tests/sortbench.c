@@ -0,0 +1,98 @@
+/*
+ * Time sorting random forwarding tables of 10k, 100k and 1M entries
+ * (or the sizes given as arguments) with qsort and memcmp, as
+ * showmacs used to, and with sort_fdbs, and check they agree.
+ * Build from this directory, after the tree was configured:
+ *	cc -O2 -I../libbridge -I../brctl -o sortbench sortbench.c \
+ *		../brctl/brctl_sort.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include "libbridge.h"
+#include "brctl.h"
+
+static int compare_fdbs(const void *_f0, const void *_f1)
+{
+	const struct fdb_entry *f0 = _f0;
+	const struct fdb_entry *f1 = _f1;
+
+	return memcmp(f0->mac_addr, f1->mac_addr, 6);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* unique addresses sharing one OUI, like the guests of a host */
+static void fill(struct fdb_entry *fdb, int n)
+{
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		memset(fdb + i, 0, sizeof(*fdb));
+		fdb[i].mac_addr[0] = 0x02;
+		fdb[i].mac_addr[1] = 0x16;
+		fdb[i].mac_addr[2] = 0x3e;
+		fdb[i].mac_addr[3] = i >> 16;
+		fdb[i].mac_addr[4] = i >> 8;
+		fdb[i].mac_addr[5] = i;
+		fdb[i].port_no = i % 64;
+	}
+
+	for (i = n - 1; i > 0; i--) {
+		struct fdb_entry t = fdb[i];
+
+		j = random() % (i + 1);
+		fdb[i] = fdb[j];
+		fdb[j] = t;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const char *sizes[] = { "10000", "100000", "1000000", NULL };
+	const char **size = argc > 1 ? (const char **) argv + 1 : sizes;
+	int failed = 0;
+
+	for (; *size; size++) {
+		int n = atoi(*size);
+		struct fdb_entry *a = malloc(n * sizeof(*a));
+		struct fdb_entry *b = malloc(n * sizeof(*b));
+		double t0, t1, t2;
+
+		if (!a || !b) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+
+		fill(a, n);
+		memcpy(b, a, n * sizeof(*a));
+
+		t0 = now();
+		qsort(a, n, sizeof(*a), compare_fdbs);
+		t1 = now();
+		if (sort_fdbs(b, n, sizeof(*b))) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		t2 = now();
+
+		printf("%8d entries: qsort %8.3f ms, sort_fdbs %8.3f ms%s\n",
+		       n, (t1 - t0) * 1e3, (t2 - t1) * 1e3,
+		       memcmp(a, b, n * sizeof(*a)) ? ", DIFFERENT" : "");
+		failed |= memcmp(a, b, n * sizeof(*a)) != 0;
+
+		free(a);
+		free(b);
+	}
+
+	return failed;
+}